@@ -0,0 +1,241 @@
+/*
+  Header-only hardware abstraction for ATtiny85/45 registers used by the blinker.
+
+  Everything is static inline and compiles to the same in/out/sbi/cbi instructions as writing
+  registers directly. Define HAL_HOST to build on a host: registers become plain variables
+  (defined once with HAL_HOST_REGISTERS), and sleeping, watchdog resets, busy waits and the global
+  interrupt flag call halHostSleep(), halHostWatchdogReset(), halHostDelay() and halHostInterrupts()
+  supplied by the host (see test/Host.h).
+
+  ATtiny85 and ATtiny45 differ only in memory sizes. ATtiny13A is not supported: it has no
+  Timer1 for the third PWM channel, and 64 bytes of RAM and 1 KB of flash do not fit the show.
+  On ATtiny45 the firmware state with a stack reserve fits 256 bytes of RAM, test/RamTest.cpp checks it.
+*/
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#ifndef HAL_HOST
+
+#if defined(__AVR_ATtiny13A__) || defined(__AVR_ATtiny13__)
+#error "ATtiny13A is not supported: no Timer1 for LED3, and 64 bytes of RAM do not hold the state (test/RamTest.cpp)"
+#elif !defined(__AVR_ATtiny85__) && !defined(__AVR_ATtiny45__)
+#error "Must be compiled for AVR ATtiny85 or ATtiny45"
+#endif
+
+#ifndef F_CPU
+#define F_CPU 1000000UL // default fuses
+#endif
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <util/delay.h>
+
+#else // HAL_HOST
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 1000000UL
+#endif
+
+#define _BV(bit) (1 << (bit))
+#define E2END 511
+
+#define HAL_HOST_REGS(R) \
+	R(PINB) R(DDRB) R(PORTB) R(ACSR) R(PRR) R(WDTCR) R(PLLCSR) R(OCR0B) R(OCR0A) R(TCCR0A) \
+	R(OCR1B) R(GTCCR) R(TCNT1) R(TCCR1) R(TCNT0) R(TCCR0B) R(MCUCR) R(TIFR) R(TIMSK) R(MCUSR)
+#define HAL_HOST_DECLARE(name) extern volatile uint8_t name;
+#define HAL_HOST_DEFINE(name) volatile uint8_t name;
+HAL_HOST_REGS(HAL_HOST_DECLARE)
+#define HAL_HOST_REGISTERS HAL_HOST_REGS(HAL_HOST_DEFINE)
+
+// bits used by the blinker, as in ATtiny85 datasheet
+enum {
+	PB0 = 0, PB1 = 1, PB2 = 2, PB3 = 3, PB4 = 4,
+	ACD = 7, PRTIM1 = 3, PRTIM0 = 2, PRUSI = 1, PRADC = 0,
+	WDIF = 7, WDIE = 6, WDP3 = 5, WDCE = 4, WDE = 3, WDRF = 3, PORF = 0,
+	LSM = 7, PCKE = 2, PLLE = 1, PLOCK = 0,
+	COM0A1 = 7, COM0A0 = 6, COM0B1 = 5, COM0B0 = 4, WGM01 = 1, WGM00 = 0, CS02 = 2, CS01 = 1, CS00 = 0,
+	PWM1B = 6, COM1B1 = 5, COM1B0 = 4, CTC1 = 7, PWM1A = 6, CS13 = 3, CS12 = 2, CS11 = 1, CS10 = 0,
+	SE = 5, SM1 = 4, SM0 = 3, OCIE0A = 4, OCF0A = 4, TOIE0 = 1, TOV0 = 1, PSR0 = 0
+};
+
+enum { WDTO_15MS, WDTO_30MS, WDTO_60MS, WDTO_120MS, WDTO_250MS, WDTO_500MS, WDTO_1S, WDTO_2S, WDTO_4S, WDTO_8S };
+
+#define ISR(vector) void vector()
+#define EMPTY_INTERRUPT(vector) void vector() {}
+#define EEMEM
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) ((uint16_t)(pgm_read_byte(p) | pgm_read_byte((const uint8_t*)(p) + 1) << 8))
+
+void halHostSleep(); // advances simulated time until the next interrupt
+void halHostWatchdogReset(); // restarts simulated watchdog timeout
+void halHostDelay(double us); // advances simulated time by a busy wait
+void halHostInterrupts(bool enabled); // sets the global interrupt flag
+uint8_t eeprom_read_byte(const uint8_t* p);
+uint16_t eeprom_read_word(const uint16_t* p);
+void eeprom_update_byte(uint8_t* p, uint8_t value);
+void eeprom_update_word(uint16_t* p, uint16_t value);
+void eeprom_read_block(void* dst, const void* src, unsigned n);
+void eeprom_update_block(const void* src, void* dst, unsigned n);
+inline void _delay_us(double us) { halHostDelay(us); }
+
+#endif // HAL_HOST
+
+namespace hal {
+
+#ifndef HAL_HOST
+inline void enableInterrupts() { __asm__ __volatile__ ("sei" ::: "memory"); }
+inline void disableInterrupts() { __asm__ __volatile__ ("cli" ::: "memory"); }
+inline void sleepCpu() { __asm__ __volatile__ ("sleep" ::: "memory"); }
+inline void watchdogReset() { __asm__ __volatile__ ("wdr"); }
+#else
+inline void enableInterrupts() { halHostInterrupts(true); }
+inline void disableInterrupts() { halHostInterrupts(false); }
+inline void sleepCpu() { halHostSleep(); }
+inline void watchdogReset() { halHostWatchdogReset(); }
+#endif
+
+// 8-bit register R, which is a tag type with static r() returning the register
+template<typename R> struct Reg {
+	static uint8_t read() { return R::r(); }
+	static void write(uint8_t v) { R::r() = v; }
+	static void set(uint8_t mask) { R::r() |= mask; }
+	static void clear(uint8_t mask) { R::r() &= ~mask; }
+	static bool any(uint8_t mask) { return (R::r() & mask) != 0; }
+};
+
+#define HAL_REG(type, name) struct type : Reg<type> { static volatile uint8_t& r() { return name; } }
+HAL_REG(PinB, PINB);
+HAL_REG(DdrB, DDRB);
+HAL_REG(PortB, PORTB);
+HAL_REG(Prr, PRR);
+HAL_REG(Timsk, TIMSK);
+HAL_REG(Tifr, TIFR);
+HAL_REG(Wdtcr, WDTCR);
+HAL_REG(Acsr, ACSR);
+HAL_REG(Mcusr, MCUSR);
+HAL_REG(Pllcsr, PLLCSR);
+#undef HAL_REG
+
+// Port B pin with number BIT
+template<uint8_t BIT> struct Pin {
+	static const uint8_t MASK = _BV(BIT);
+	static void high() { PortB::set(MASK); }
+	static void low() { PortB::clear(MASK); }
+	static void output() { DdrB::set(MASK); }
+	static void input() { DdrB::clear(MASK); }
+	static bool read() { return PinB::any(MASK); }
+};
+
+// Power reduction for peripherals with the given PRR mask
+struct Power {
+	static const uint8_t UNUSED = _BV(PRUSI) | _BV(PRADC);
+	static void on(uint8_t mask) { Prr::clear(mask); }
+	static void off(uint8_t mask) { Prr::set(mask); }
+};
+
+struct Comparator {
+	static void off() { Acsr::write(_BV(ACD)); }
+};
+
+// Timer0 in fast PWM mode on OC0A and OC0B
+struct Timer0 {
+	static const uint8_t PRR_MASK = _BV(PRTIM0);
+	// fast PWM with inverting outputs (set on match, clear at BOTTOM): on for 255 - compare value
+	// counts, so 0xff is a true off and no output is switched outside BOTTOM
+	static void pwm() {
+		TCCR0A = _BV(WGM01) | _BV(WGM00) | _BV(COM0A1) | _BV(COM0A0) | _BV(COM0B1) | _BV(COM0B0);
+	}
+	static void start() { TCCR0B = _BV(CS00); } // no prescaler
+	static void stop() { TCCR0A = 0; TCCR0B = 0; }
+	static void reset() { TCNT0 = 0; }
+	static void compareA(uint8_t v) { OCR0A = v; }
+	static void compareB(uint8_t v) { OCR0B = v; }
+	static void enableOverflow() { Timsk::set(_BV(TOIE0)); Tifr::set(_BV(TOV0)); }
+	static void disableOverflow() { Timsk::clear(_BV(TOIE0)); }
+	// counts F_CPU / 1024 (~1ms) ticks in normal mode from 0 with compare A interrupt after n ticks
+	static void startTicks(uint8_t n) {
+		TCCR0A = 0;
+		GTCCR = _BV(PSR0); // reset prescaler for a whole first tick, Timer1 is off
+		TCNT0 = 0;
+		OCR0A = n;
+		Tifr::set(_BV(OCF0A));
+		Timsk::set(_BV(OCIE0A));
+		TCCR0B = _BV(CS02) | _BV(CS00);
+	}
+	static void stopTicks() { Timsk::clear(_BV(OCIE0A)); TCCR0B = 0; }
+	static uint8_t count() { return TCNT0; }
+};
+
+// Timer1 in PWM mode on OC1B
+struct Timer1 {
+	static const uint8_t PRR_MASK = _BV(PRTIM1);
+	// PWM mode on OCR1B with inverting output as Timer0::pwm()
+	static void pwmB() { GTCCR = _BV(PWM1B) | _BV(COM1B1) | _BV(COM1B0); }
+	static void start() { TCCR1 = _BV(CS10); } // no prescaler
+	static void stop() { GTCCR = 0; TCCR1 = 0; }
+	static void reset() { TCNT1 = 0; }
+	static void compareB(uint8_t v) { OCR1B = v; }
+	// clocks Timer1 from the PLL in low speed mode (32MHz, also rated below 2.7V), PWM Freq ~= 125 KHz
+	static void pllStart() {
+		PLLCSR = _BV(LSM) | _BV(PLLE);
+		_delay_us(100); // PLL stabilizes before lock is polled
+		while (!Pllcsr::any(_BV(PLOCK)))
+			;
+		Pllcsr::set(_BV(PCKE));
+	}
+	static void pllStop() { PLLCSR = 0; } // back to the system clock, PLL off
+};
+
+// Sleep modes, the CPU sleeps with interrupts enabled until one of them happens
+struct Sleep {
+	static void idle() { MCUCR = (MCUCR & ~(_BV(SM1) | _BV(SM0))); }
+	static void powerDown() { MCUCR = (MCUCR & ~(_BV(SM1) | _BV(SM0))) | _BV(SM1); }
+	static void enable() { MCUCR |= _BV(SE); }
+	static void wait() {
+		enableInterrupts();
+		sleepCpu();
+		disableInterrupts();
+	}
+};
+
+// Watchdog interrupt used to wake up from sleep, or interrupt and reset to recover from a hang
+struct Watchdog {
+	static bool wasReset() { return Mcusr::any(_BV(WDRF)); }
+	// clears reset flag that keeps watchdog enabled after reset and turns it off
+	static void disable() {
+		Mcusr::write(0);
+		Wdtcr::set(_BV(WDCE) | _BV(WDE));
+		Wdtcr::write(0);
+	}
+	// interrupt on first timeout and reset on second unless kicked more often than wdto
+	static void guard(uint8_t wdto) {
+		Wdtcr::set(_BV(WDCE) | _BV(WDE));
+		Wdtcr::write(_BV(WDIE) | _BV(WDE) | (wdto & 7) | (wdto >> 3 << WDP3));
+		watchdogReset();
+	}
+	static void kick() { watchdogReset(); }
+	static __attribute__((noinline)) void sleepImpl(uint8_t wdtcr) {
+		Wdtcr::set(_BV(WDCE)); // enable the WDT Change Bit
+		Wdtcr::write(wdtcr);
+		watchdogReset(); // start counting with new timeout setting
+		Wdtcr::set(_BV(WDIF)); // now reset interrupt flag [again] after all config / timer reset done
+		Sleep::wait();
+	}
+	// sleeps for the watchdog timeout wdto, the WDTCR value is computed statically for constant wdto
+	static inline __attribute__((always_inline)) void sleep(uint8_t wdto) {
+		// note: bit 3 is separate
+		sleepImpl(_BV(WDIF) | _BV(WDIE) | (wdto & 7) | (wdto >> 3 << WDP3));
+	}
+};
+
+} // namespace hal
+
+#endif // HAL_H_
@@ -0,0 +1,105 @@
+/*
+  Compressed light patterns in flash: a byte string of records, each one a keyframe reached by a
+  linear ramp of the three channel levels over 2^n ticks, or a run length hold of the current
+  levels, and an end mark. Ramp lengths are powers of 2, so per tick increments are exact 8.8
+  fixed point values; they are computed at compile time and decoding is three word reads per
+  keyframe and three adds per tick. Raw frames take 3 bytes per tick, a ramp record takes 7 bytes
+  for up to 128. tools/PatternEncoder converts a CSV of keyframes into records.
+
+    PATTERN_FADE(n, a1, a2, a3, b1, b2, b3) - ramp from levels a1..a3 to b1..b3 over 2^n ticks, n = 0..7,
+                                              levels are mapped by PATTERN_LEVEL(level, channel) that the
+                                              pattern source defines (e.g. white balance)
+    PATTERN_RAMP(n, d1, d2, d3)             - change levels by d1..d3 (-255..255, -127..127 for n = 0)
+    PATTERN_HOLD(ticks)                     - keep levels for 1..127 ticks
+    PATTERN_END                             - levels should be back at 0
+*/
+
+#ifndef PATTERN_H_
+#define PATTERN_H_
+
+#include "Hal.h"
+
+// 8.8 fixed point increment per tick of a level change by d over 2^n ticks
+constexpr int16_t patternStep(uint8_t n, int16_t d) {
+	return d * 256 / (1 << n);
+}
+
+#define PATTERN_WORD(w) (uint8_t)(w), (uint8_t)((uint16_t)(w) >> 8)
+#define PATTERN_RAMP(n, d1, d2, d3) (uint8_t)((1 << (n)) - 1), \
+	PATTERN_WORD(patternStep(n, d1)), PATTERN_WORD(patternStep(n, d2)), PATTERN_WORD(patternStep(n, d3))
+#define PATTERN_FADE(n, a1, a2, a3, b1, b2, b3) PATTERN_RAMP(n, \
+	PATTERN_LEVEL(b1, 0) - PATTERN_LEVEL(a1, 0), PATTERN_LEVEL(b2, 1) - PATTERN_LEVEL(a2, 1), \
+	PATTERN_LEVEL(b3, 2) - PATTERN_LEVEL(a3, 2))
+#define PATTERN_HOLD(ticks) (0x80 | (ticks))
+#define PATTERN_END 0x80
+
+// ramp record: ticks - 1, then little endian 8.8 steps of the three channels
+const uint8_t PATTERN_RAMP_SIZE = 7;
+
+// channel c level change over ramp record p
+constexpr int16_t patternDelta(const uint8_t* p, uint8_t c) {
+	return (int16_t)(p[1 + 2 * c] | p[2 + 2 * c] << 8) * (*p + 1) / 256;
+}
+
+// pattern length in ticks
+constexpr uint16_t patternTicks(const uint8_t* p) {
+	return *p == PATTERN_END ? 0 :
+		*p & 0x80 ? (*p & 0x7f) + patternTicks(p + 1) :
+		(*p + 1) + patternTicks(p + PATTERN_RAMP_SIZE);
+}
+
+// channel c level at the end of pattern
+constexpr int16_t patternLevel(const uint8_t* p, uint8_t c, int16_t level = 0) {
+	return *p == PATTERN_END ? level :
+		*p & 0x80 ? patternLevel(p + 1, c, level) :
+		patternLevel(p + PATTERN_RAMP_SIZE, c, level + patternDelta(p, c));
+}
+
+// sum of all channel levels over pattern ticks, for energy use
+constexpr uint32_t patternLevelTicks(const uint8_t* p, int16_t sum = 0) {
+	return *p == PATTERN_END ? 0 :
+		*p & 0x80 ? (uint32_t)sum * (*p & 0x7f) + patternLevelTicks(p + 1, sum) :
+		(uint32_t)(2 * sum + patternDelta(p, 0) + patternDelta(p, 1) + patternDelta(p, 2)) * (*p + 1) / 2 +
+			patternLevelTicks(p + PATTERN_RAMP_SIZE, sum + patternDelta(p, 0) + patternDelta(p, 1) + patternDelta(p, 2));
+}
+
+// Streaming decoder of a pattern in flash, one frame of 8.8 fixed point levels per tick;
+// each tick reads at most one record
+struct PatternPlayer {
+	const uint8_t* next; // next record in flash
+	uint8_t left; // ticks left in current record
+	uint16_t s1, s2, s3;
+	int16_t d1, d2, d3;
+
+	void start(const uint8_t* pattern) {
+		next = pattern;
+		left = 0;
+		s1 = s2 = s3 = 0;
+	}
+
+	// advances to the next frame, returns false at the end of pattern
+	bool tick() {
+		if (left == 0) {
+			uint8_t h = pgm_read_byte(next++);
+			if (h == PATTERN_END)
+				return false;
+			if (h & 0x80) {
+				left = h & 0x7f;
+				d1 = d2 = d3 = 0;
+			} else {
+				left = h + 1;
+				d1 = pgm_read_word(next);
+				d2 = pgm_read_word(next + 2);
+				d3 = pgm_read_word(next + 4);
+				next += PATTERN_RAMP_SIZE - 1;
+			}
+		}
+		left--;
+		s1 += d1;
+		s2 += d2;
+		s3 += d3;
+		return true;
+	}
+};
+
+#endif // PATTERN_H_
@@ -0,0 +1,18 @@
+/*
+  Stackless protothreads after Adam Dunkels: a task is a function that returns at each wait
+  point and continues from it on the next call, its state is the line of the wait point.
+  Local variables are not kept across waits and tasks must not use switch statements.
+*/
+
+#ifndef PT_H_
+#define PT_H_
+
+#include <stdint.h>
+
+typedef uint16_t Pt; // 0 to start from the beginning
+
+#define PT_BEGIN(pt) switch (pt) { case 0:
+#define PT_WAIT_UNTIL(pt, cond) do { (pt) = __LINE__; case __LINE__: if (!(cond)) return; } while (0)
+#define PT_END(pt) } (pt) = 0
+
+#endif // PT_H_
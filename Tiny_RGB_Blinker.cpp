@@ -11,6 +11,8 @@
   Use a common cathode RGB LED.
   Use 3V CR2032 battery.
   Use default fuses (1MHz).
+
+  ATtiny45 uses the same pins.
   
   Connect common cathode to LED0.
   The anode colors at LED1, LED2, LED3 does not really matter in code, but the actual colors are:
@@ -19,22 +21,179 @@
     LED3 - RED
 */
 
-#ifndef __AVR_ATtiny85__
-#error "Must be compiled for AVR ATtiny85"
+#include <stddef.h>
+#include "Hal.h"
+#include "Pt.h"
+#include "Pattern.h"
+
+// Trace is a preprocessor flag as it changes interrupt vectors; when 0 it adds no code at all
+#ifndef TRACE
+#define TRACE 0 // 1 to send trace events on PB3 as 9600 baud 8N1 bytes, see tools/TraceDecoder
 #endif
 
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <avr/sleep.h>
-#include <avr/wdt.h>
+using namespace hal;
+
+// Default configuration. Enclosure variants derive from it overriding members in a header
+// passed with -DCONFIG_H=\"...\" -DCONFIG=...; everything is compile-time constant.
+struct DefaultConfig {
+	// Pins, LED1 and LED2 are fixed by Timer0 outputs and LED3 by Timer1 output
+	static constexpr uint8_t LED0_BIT = 2; // common cathode on INT0
+	static constexpr uint8_t LED1_BIT = 0; // OC0A
+	static constexpr uint8_t LED2_BIT = 1; // OC0B
+	static constexpr uint8_t LED3_BIT = 4; // OC1B
+
+	// Show is SHOW_CYCLES cycles (2 min) of RAMP_STEPS x 1ms ramp up and down (~0.5s)
+	static constexpr uint8_t SHOW_CYCLES = 240;
+	static constexpr uint16_t RAMP_STEPS = 256; // power of 2
+	// Clock Timer1 from the PLL for ~125 KHz PWM on LED3 that cameras do not alias, at the cost of
+	// PLL_UA while lit cycles run
+	static constexpr bool TIMER1_PLL = false;
+	// Saturation of show colors, lower values mix in the other channels towards white
+	static constexpr uint8_t SATURATION = 0xff;
+	// White balance: channel levels are scaled by LEDn_SCALE / 255 to even out perceived brightness
+	// of LED1 (blue), LED2 (green) and LED3 (red), e.g. green is several times brighter at the same duty
+	static constexpr uint8_t LED1_SCALE = 0xff;
+	static constexpr uint8_t LED2_SCALE = 0xff;
+	static constexpr uint8_t LED3_SCALE = 0xff;
+
+	// Message for EFFECT_MESSAGE in Morse code, up to 16 letters and digits (other characters are word gaps),
+	// one letter per show cycle in hue MESSAGE_HUE of 48 (16 is LED2); gaps are slept without PWM. The show
+	// repeats the whole message for about as long as a show of lit cycles
+	static constexpr const char* MESSAGE = "SOS";
+	static constexpr uint8_t MESSAGE_HUE = 16;
+	static constexpr uint8_t MORSE_UNIT_MS = 200; // dot length
+	static constexpr uint8_t MORSE_FADE_MS = 32; // power of 2, fade in and out of a symbol
+
+	// Watchdog timeouts for polling light between shows, idle show cycle and flashlight gestures
+	static constexpr uint8_t POLL_WDTO = WDTO_8S;
+	static constexpr uint8_t IDLE_WDTO = WDTO_250MS; // rest of idle cycle after light sensing
+	static constexpr uint8_t GESTURE_WDTO = WDTO_500MS;
+
+	// Sense light at least every 8 cycles (~4s) during the show when there was no idle cycle to do it
+	static constexpr uint8_t SENSE_CYCLES = 8;
 
-const uint8_t LED0_BIT = 2;
-const uint8_t LED1_BIT = 0;
-const uint8_t LED2_BIT = 1;
-const uint8_t LED3_BIT = 4;
+	// Reverse charging LED capacitance from the pin takes well under a microsecond, so a short busy
+	// wait is used instead of a watchdog sleep that would start the WDT oscillator and wake up again
+	static constexpr uint8_t CHARGE_US = 10;
 
+	// Night when LED has not discharged within NIGHT_WDTO. During the show light level is measured
+	// with doubling waits of 15, 30, 60, 120ms, still charged after NIGHT_LEVEL of them (225ms) is night
+	static constexpr uint8_t NIGHT_WDTO = WDTO_250MS;
+	static constexpr uint8_t NIGHT_LEVEL = 4;
+
+	// Light seen at night is polled Config::GESTURE_POLLS times (~6s) to recognize two flashlight flashes,
+	// the first flash must last through one night polling period to be noticed
+	static constexpr uint8_t GESTURE_POLLS = 8;
+
+	// Night length learning
+	static constexpr uint16_t PRE_DAWN_MINUTES = 60; // run second show before expected dawn, 0 to disable
+	static constexpr uint16_t MIN_NIGHT_MINUTES = 4 * 60; // shorter nights are not learned (clouds, shadows)
+	static constexpr uint16_t MAX_NIGHT_MINUTES = 18 * 60; // longer nights are not learned (covered sensor)
+
+	// Energy budget for the target battery life
+	static constexpr uint16_t BATTERY_MAH = 220; // CR2032
+	static constexpr uint8_t LIFETIME_MONTHS = 12;
+	// Estimated currents in uA (rough datasheet and CR2032 figures at 3V)
+	static constexpr uint8_t SLEEP_UA = 5; // power-down with WDT, including light sensing
+	static constexpr uint16_t IDLE_UA = 250; // idle sleep with timers during lit cycle
+	static constexpr uint16_t LED_UA = 10000; // one LED channel at full duty
+	static constexpr uint16_t PLL_UA = 2000; // PLL in low speed mode with TIMER1_PLL, a guess to measure
+
+	// Runtime statistics in EEPROM, written once a day round robin into STATS_SLOTS slots
+	static constexpr bool STATS = true;
+	static constexpr uint8_t STATS_SLOTS = 8;
+
+	// Check for a programmer on PB3 at boot to receive show parameters into EEPROM (PB3 is shared with trace)
+	static constexpr bool CONFIG_WIRE = !TRACE;
+};
+
+#ifdef CONFIG_H
+#include CONFIG_H
+#endif
+#ifndef CONFIG
+#define CONFIG DefaultConfig
+#endif
+typedef CONFIG Config;
+
+static_assert(Config::LED1_BIT == PB0 && Config::LED2_BIT == PB1, "LED1 and LED2 must be on OC0A and OC0B");
+static_assert(Config::LED3_BIT == PB4, "LED3 must be on OC1B");
+static_assert(!TRACE || Config::LED0_BIT != PB3, "PB3 is used for trace");
+static_assert(!TRACE || !Config::CONFIG_WIRE, "PB3 is used for either trace or configuration wire");
+static_assert(Config::RAMP_STEPS >= 2 && Config::RAMP_STEPS <= 256 && (Config::RAMP_STEPS & (Config::RAMP_STEPS - 1)) == 0,
+	"RAMP_STEPS must be a power of 2 up to 256");
+static_assert(Config::SENSE_CYCLES > 0 && Config::GESTURE_POLLS > 0, "SENSE_CYCLES and GESTURE_POLLS must be positive");
+static_assert(Config::NIGHT_LEVEL > 0 && Config::NIGHT_LEVEL <= WDTO_2S + 1, "NIGHT_LEVEL must be 1 to 8 doubling waits");
+static_assert(Config::MIN_NIGHT_MINUTES < Config::MAX_NIGHT_MINUTES && Config::MAX_NIGHT_MINUTES <= 24 * 60,
+	"Night length limits must be ordered and within a day");
+
+const uint8_t LED_BITS = _BV(Config::LED0_BIT) | _BV(Config::LED1_BIT) | _BV(Config::LED2_BIT) | _BV(Config::LED3_BIT);
+typedef Pin<Config::LED0_BIT> Led0;
+
+// Ramp value increment per step so that 8.8 fixed point value reaches the peak in RAMP_STEPS
+const uint8_t RAMP_INC = 256 / Config::RAMP_STEPS;
+
+// Night length is measured in polling periods (watchdog timeout is 16ms << wdto)
+const uint16_t PERIOD_MS = 16U << Config::POLL_WDTO;
+const uint16_t PRE_DAWN_PERIODS = Config::PRE_DAWN_MINUTES * 60000UL / PERIOD_MS;
+const uint16_t MIN_NIGHT_PERIODS = Config::MIN_NIGHT_MINUTES * 60000UL / PERIOD_MS;
+const uint16_t MAX_NIGHT_PERIODS = Config::MAX_NIGHT_MINUTES * 60000UL / PERIOD_MS;
+
+// Energy budget in uAs (uA x s) per polling period, ~208 for 220mAh in 12 months with 8s periods
+const uint16_t BUDGET_UAS = (uint32_t)Config::BATTERY_MAH * PERIOD_MS / (Config::LIFETIME_MONTHS * 30UL * 24);
+// Estimated charge use in uAs
+const uint16_t CYCLE_MS = 2 * Config::RAMP_STEPS * 1024000UL / F_CPU; // 4 x 256 clock PWM periods per step
+const uint16_t PERIOD_UAS = ((uint32_t)Config::SLEEP_UA * PERIOD_MS + 500) / 1000;
+const uint16_t CYCLE_UAS = (uint32_t)(Config::IDLE_UA + (Config::TIMER1_PLL ? Config::PLL_UA : 0)) * CYCLE_MS / 1000;
+// per unit of channel peak, 1/2 avg on ramp, in 8.8 fixed point as the unit is ~10uAs
+const uint16_t LED_UAS = (uint32_t)Config::LED_UA * CYCLE_MS / 1000 * 256 / (2 * 0xff);
+const uint32_t MAX_CHARGE = (uint32_t)BUDGET_UAS * (24 * 3600000UL / PERIOD_MS); // save up to one day of budget
+
+static_assert(BUDGET_UAS > PERIOD_UAS, "Sleep alone exceeds energy budget for the battery lifetime");
+
+// Trace event byte is event in 3 high bits | 5 bit argument
+enum TraceEvent : uint8_t {
+	TRACE_SLEEP = 0x00, // watchdog sleep entry, argument is wdto
+	TRACE_WAKE = 0x20, // watchdog sleep exit
+	TRACE_ISR = 0x40, // wake up interrupt entry, argument is TraceIsr
+	TRACE_CYCLE = 0x60, // show cycle start, argument is kind (0 for idle)
+	TRACE_LIGHT = 0x80, // light sensing result, argument is darkness level
+	TRACE_SHOW = 0xA0 // show start, argument is ShowStart
+};
+
+enum TraceIsr : uint8_t { TRACE_WDT, TRACE_TIMER };
+
+#if TRACE
+typedef Pin<PB3> TraceTx;
+
+// sends event byte as UART frame on PB3, called with interrupts disabled; Timer0 overflows are not traced
+void traceImpl(uint8_t e) {
+	uint16_t frame = (e << 1) | 0x200; // start bit 0, 8 data bits LSB first, stop bit 1
+	for (uint8_t i = 0; i < 10; i++) {
+		if (frame & 1)
+			TraceTx::high();
+		else
+			TraceTx::low();
+		frame >>= 1;
+		_delay_us(100); // 104us bit at 9600 baud minus loop overhead at 1MHz
+	}
+}
+#endif
+
+inline __attribute__((always_inline)) void trace(uint8_t e) {
+#if TRACE
+	traceImpl(e);
+#else
+	(void)e;
+#endif
+}
+
+#if TRACE
+ISR(WDT_vect) { trace(TRACE_ISR | TRACE_WDT); }
+ISR(TIM0_COMPA_vect) { trace(TRACE_ISR | TRACE_TIMER); }
+#else
 EMPTY_INTERRUPT(WDT_vect);
-EMPTY_INTERRUPT(INT0_vect);
+EMPTY_INTERRUPT(TIM0_COMPA_vect); // timer service ticks
+#endif
 
 volatile uint8_t tcnt0h; // overflow counter high
 
@@ -42,44 +201,59 @@ ISR(TIM0_OVF_vect) {
 	tcnt0h++;
 }
 
-void wdSleepImpl(uint8_t wdtcr) {
-	WDTCR |= _BV(WDCE); // enable the WDT Change Bit
-	WDTCR = wdtcr;
-	wdt_reset(); // start counting with new timeout setting
-	WDTCR |= _BV(WDIF); // now reset interrupt flag [again] after all config / timer reset done
-	sei();
-	sleep_cpu();
-	cli();
+inline __attribute__((always_inline)) void wdSleep(uint8_t wdto) {
+	trace(TRACE_SLEEP | wdto);
+	Watchdog::sleep(wdto);
+	trace(TRACE_WAKE);
 }
 
-inline __attribute__((always_inline)) void wdSleep(uint8_t wdto) {
-	// statically compute WDTCR value to enable WDT Interrupt and set timeout
-	// note: bit 3 is separate
-	wdSleepImpl(_BV(WDIF) | _BV(WDIE) | (wdto & 7) | (wdto >> 3 << WDP3));
-}
-
-bool night() {
-	// charge
-	PORTB |= _BV(LED0_BIT);
-	wdSleep(WDTO_15MS);
-	DDRB &= ~_BV(LED0_BIT);
-	PORTB &= ~_BV(LED0_BIT);
-	// wait discharge
-	GIMSK |= _BV(INT0); // enable INT0 (default = when low)
-	GIFR |= _BV(INTF0); // reset interrupt flag
-	wdSleep(WDTO_250MS);
-	bool result = (PINB & _BV(LED0_BIT)) != 0; // night if has not discharged yet
-	GIMSK &= ~_BV(INT0); // disable INT0
-	// back to output
-	DDRB |= _BV(LED0_BIT);
-	return result;
-}
-
-// XABC fast random generator (with a CAFEBABE seed)
-uint8_t x = 0xCA;
-uint8_t a = 0XFE;
-uint8_t b = 0xBA;
-uint8_t c = 0xBE;
+// true while sensing LED junction is still charged
+inline bool charged() {
+	return Led0::read();
+}
+
+// reverse charges LED junction, photocurrent discharges it
+void startSensing() {
+	Led0::high();
+	_delay_us(Config::CHARGE_US);
+	Led0::input();
+	Led0::low();
+}
+
+void stopSensing(uint8_t level) {
+	Led0::output(); // back to output
+	trace(TRACE_LIGHT | level);
+}
+
+// State in .noinit RAM is kept over watchdog reset to resume a hung show
+#define NOINIT __attribute__((section(".noinit")))
+
+const uint8_t RESUME_MAGIC = 0x5a;
+
+// Shows by the main loop state they start from, day shows stop at night and night shows at dawn
+enum ShowStart : uint8_t { SHOW_BOOT, SHOW_DAWN, SHOW_PRE_DAWN, SHOW_GESTURE };
+
+struct Resume {
+	uint8_t magic; // RESUME_MAGIC while a show is running
+	uint8_t cycle; // current show cycle
+	ShowStart start; // show that is running
+	uint16_t night; // periods from dusk to the start of a night show
+};
+
+Resume resume NOINIT;
+
+// XABC fast random generator (with a CAFEBABE seed at power up)
+uint8_t x NOINIT;
+uint8_t a NOINIT;
+uint8_t b NOINIT;
+uint8_t c NOINIT;
+
+void seedRandom() {
+	x = 0xCA;
+	a = 0XFE;
+	b = 0xBA;
+	c = 0xBE;
+}
 
 // returns random number from 0 to 255
 uint8_t random() {
@@ -90,130 +264,924 @@ uint8_t random() {
 	return c;            //low order bits of other variables
 }
 
-// waits ~1ms using Timer0 overflow, (need to wait ~4 overflows at 1Mhz) 
-void waitTimer() {
-	tcnt0h = 0;
-	while (tcnt0h < 4) {
-		sei();
-		sleep_cpu(); // idle sleep (configured in animateOne) until overflow interrupt happens
-		cli();
-	}
-}
-
-// 500ms action
-inline void animateOne() {
-	uint8_t p1 = 0;
-	uint8_t p2 = 0;
-	uint8_t p3 = 0;
-	switch (random() & 3) {
-		case 0:
-			wdSleep(WDTO_500MS); 
-			return; // nothing else in this cycle
-		case 1:
-			p1 = 0xff;
-			if (random() & 1)
-				p2 = random();
-			else
-				p3 = random();
-			break;
-		case 2:
-			p2 = 0xff;
-			if (random() & 1) 
-				p1 = random();
-			else
-				p3 = random();
-			break;
-		case 3:
-			p3 = 0xff;
-			if (random() & 1)
-				p1 = random();
-			else
-				p2 = random();
+// Runtime statistics, early stops by light are shows - fullShows - budgetStops; 32 bit counters go first
+// so that there is no padding on the host either
+struct Stats {
+	uint32_t cycles; // lit cycles played
+	uint32_t usedUAs; // estimated charge used in uAs
+	uint16_t nights; // nights seen
+	uint16_t shows; // shows started
+	uint16_t fullShows; // shows that played all cycles
+	uint16_t budgetStops; // shows trimmed by energy budget
+	uint16_t lightFlips; // light seen at night that was not dawn (flashlight, headlights)
+	uint16_t resets; // watchdog resets that resumed a show
+	uint16_t tickClocks; // longest scheduler pass between lit cycle ticks in CPU clocks, timed by Timer0
+	uint16_t lateTicks; // lit cycle ticks whose first period began before its compare values were written
+};
+
+// Show effects
+enum Effect : uint8_t {
+	EFFECT_HUES, // random hue at full value
+	EFFECT_ONE_COLOR, // primary hues only, less energy
+	EFFECT_EFFICIENT, // hues from green to red, more perceived light per energy
+	EFFECT_PATTERN, // lightPattern on every lit cycle
+	EFFECT_MESSAGE, // Config::MESSAGE in Morse code
+	EFFECTS
+};
+
+// Show parameters that can be changed without reflashing through the configuration wire
+struct Params {
+	uint8_t showCycles; // show length in cycles
+	uint8_t dim; // brightness is divided by 2^dim
+	uint8_t effect;
+};
+
+// EEPROM contents from address 0, read from a dump by tools/StatsExtractor. Statistics are written once a
+// day round robin into slots, the latest slot is the one whose sequence number is not followed by the next one.
+const uint8_t EEPROM_LAYOUT = 2; // changes with the layout
+struct Eeprom {
+	uint16_t nightLength; // estimated night length in polling periods, 0 when not known yet
+	Params params;
+	uint8_t paramsCheck; // paramsCheck(params)
+	uint8_t layout; // EEPROM_LAYOUT, written with the statistics
+	uint8_t statsSlots; // Config::STATS_SLOTS, written with the statistics
+	Stats stats[Config::STATS_SLOTS];
+	uint8_t statsSeq[Config::STATS_SLOTS]; // slot sequence numbers
+};
+
+Eeprom EEMEM eeprom;
+
+static_assert(offsetof(Eeprom, layout) == 6 && offsetof(Eeprom, stats) == 8 && sizeof(Stats) == 24,
+	"EEPROM layout of tools/StatsExtractor");
+static_assert(!Config::STATS || (Config::STATS_SLOTS > 0 && Config::STATS_SLOTS < 0xff), "STATS_SLOTS out of range");
+static_assert(offsetof(Eeprom, statsSeq) + Config::STATS_SLOTS <= E2END + 1, "EEPROM is too small");
+
+uint16_t nightLength;
+
+// updates running estimate of night length with the measured one (weight 1/4) and saves it
+void learnNight(uint16_t periods) {
+	if (periods < MIN_NIGHT_PERIODS || periods > MAX_NIGHT_PERIODS)
+		return;
+	if (nightLength == 0)
+		nightLength = periods; // first night learned
+	else
+		nightLength += (int16_t)(periods - nightLength) / 4;
+	eeprom_update_word(&eeprom.nightLength, nightLength); // once per night, no EEPROM wear concern
+}
+
+Stats stats;
+uint8_t statsSlot; // latest slot index
+uint8_t statsSeq; // latest slot sequence number
+
+inline void count(uint16_t& counter) {
+	if (Config::STATS)
+		counter++;
+}
+
+inline void countCharge(uint32_t uas) {
+	if (Config::STATS)
+		stats.usedUAs += uas;
+}
+
+void loadStats() {
+	uint8_t i = 0;
+	uint8_t seq = eeprom_read_byte(&eeprom.statsSeq[0]);
+	while (i + 1 < Config::STATS_SLOTS && eeprom_read_byte(&eeprom.statsSeq[i + 1]) == (uint8_t)(seq + 1)) {
+		i++;
+		seq++;
+	}
+	statsSlot = i;
+	statsSeq = seq;
+	eeprom_read_block(&stats, &eeprom.stats[i], sizeof(Stats));
+	if (stats.nights == 0xffff) { // erased EEPROM
+		uint8_t* p = (uint8_t*)&stats;
+		for (uint8_t j = 0; j < sizeof(Stats); j++)
+			p[j] = 0;
 	}
+}
+
+// writes statistics to the next slot, sequence number goes last so an interrupted write keeps the previous slot
+void flushStats() {
+	if (++statsSlot == Config::STATS_SLOTS)
+		statsSlot = 0;
+	eeprom_update_block(&stats, &eeprom.stats[statsSlot], sizeof(Stats));
+	eeprom_update_byte(&eeprom.statsSeq[statsSlot], ++statsSeq);
+	eeprom_update_byte(&eeprom.layout, EEPROM_LAYOUT); // written once, update skips equal bytes
+	eeprom_update_byte(&eeprom.statsSlots, Config::STATS_SLOTS);
+}
+
+Params params = { Config::SHOW_CYCLES, 0, EFFECT_HUES };
+
+typedef Pin<PB3> ConfigWire;
+
+uint8_t paramsCheck(const Params& p) {
+	const uint8_t* b = (const uint8_t*)&p;
+	uint8_t sum = 0x5a; // erased or zeroed EEPROM does not pass
+	for (uint8_t i = 0; i < sizeof(Params); i++)
+		sum += b[i];
+	return sum;
+}
+
+bool paramsValid(const Params& p) {
+	return p.showCycles != 0 && p.dim < 8 && p.effect < EFFECTS;
+}
+
+void loadParams() {
+	Params p;
+	eeprom_read_block(&p, &eeprom.params, sizeof(Params));
+	if (eeprom_read_byte(&eeprom.paramsCheck) == paramsCheck(p) && paramsValid(p))
+		params = p;
+}
+
+// receives 9600 baud 8N1 byte from the configuration wire, returns false on ~1s timeout
+bool wireReceive(uint8_t& b) {
+	uint16_t t = 0;
+	while (!ConfigWire::read()) { // wait for the stop bit of the previous byte
+		if (++t == 0)
+			return false;
+		_delay_us(8);
+	}
+	while (ConfigWire::read()) { // wait for start bit
+		if (++t == 0)
+			return false;
+		_delay_us(8); // polled every ~15us at 1MHz
+	}
+	_delay_us(150); // to the middle of the first data bit: 1.5 bits minus polling delay and overhead at 1MHz
+	for (uint8_t i = 0; i < 8; i++) {
+		b >>= 1;
+		if (ConfigWire::read())
+			b |= 0x80;
+		_delay_us(98); // 104us bit minus loop overhead
+	}
+	return true;
+}
+
+// A programmer (tools/WireSender) holds PB3 low at power up, releases it within ~8s and sends 'P',
+// Params bytes and paramsCheck() as 9600 baud 8N1; valid parameters are saved and true is returned
+// to acknowledge them with a blink. Without a programmer PB3 is pulled up and this is a single pin read.
+bool wireConfig() {
+	_delay_us(10); // let pull-up settle
+	if (ConfigWire::read())
+		return false;
+	uint16_t t = 0;
+	while (!ConfigWire::read()) { // wait for release
+		if (++t == 0)
+			return false;
+		_delay_us(128);
+	}
+	uint8_t b[2 + sizeof(Params)];
+	for (uint8_t i = 0; i < sizeof(b); i++)
+		if (!wireReceive(b[i]))
+			return false;
+	Params p;
+	for (uint8_t i = 0; i < sizeof(Params); i++)
+		((uint8_t*)&p)[i] = b[1 + i];
+	if (b[0] != 'P' || b[1 + sizeof(Params)] != paramsCheck(p) || !paramsValid(p))
+		return false;
+	eeprom_update_block(&p, &eeprom.params, sizeof(Params));
+	eeprom_update_byte(&eeprom.paramsCheck, paramsCheck(p));
+	return true;
+}
+
+uint8_t tickEnd; // Timer0 overflow count at the end of the last lit cycle tick
+
+// waits until Timer0 overflow count reaches t
+inline void waitOverflows(uint8_t t) {
+	while ((int8_t)(tcnt0h - t) < 0)
+		Sleep::wait(); // idle sleep (configured in startCycle) until overflow interrupt happens
+}
+
+// outputs 8.8 fixed point channel values for ~1ms = 4 PWM periods (Timer0 overflows at 1Mhz),
+// ordered dither of compare values between periods gives 2 extra bits of resolution at low levels.
+// Outputs are inverting, so 0 is a true off (compare value 0 would still emit a one count spike
+// in non-inverting fast PWM) and only double buffered compare values change, at BOTTOM.
+// Ticks end at a running overflow count and interrupts stay enabled between them, so a scheduler
+// pass longer than a period plays the previous values in the periods it overran but loses no time.
+void outputTick(uint16_t s1, uint16_t s2, uint16_t s3) {
+	disableInterrupts();
+	uint8_t start = tickEnd;
+	tickEnd += 4;
+	uint8_t late = tcnt0h - start; // periods of this tick already begun
+	if (Config::STATS) {
+		uint16_t clocks = (uint16_t)late << 8 | Timer0::count();
+		if (clocks > stats.tickClocks)
+			stats.tickClocks = clocks;
+		if (late != 0)
+			count(stats.lateTicks);
+	}
+	for (uint8_t k = late; k < 4; k++) {
+		uint8_t d = (k & 1 ? 0x80 : 0) | (k & 2 ? 0x40 : 0); // 0x00, 0x80, 0x40, 0xC0; no overflow as s <= 0xff00
+		uint8_t c1 = (s1 + d) >> 8;
+		uint8_t c2 = (s2 + d) >> 8;
+		uint8_t c3 = (s3 + d) >> 8;
+		Timer0::compareA(~c1); // compare values are double buffered and take effect at the next period
+		Timer0::compareB(~c2);
+		Timer1::compareB(~c3);
+		waitOverflows(start + k + 1);
+	}
+	Watchdog::kick();
+	enableInterrupts(); // the overflow interrupt counts periods during the scheduler pass
+}
+
+// remaining energy budget in uAs, credited every polling period and debited by each lit cycle
+uint32_t charge NOINIT;
+
+// credits energy budget share of one polling period less the sleep current it uses
+void creditPeriod() {
+	countCharge(PERIOD_UAS);
+	charge += BUDGET_UAS - PERIOD_UAS;
+	if (charge > MAX_CHARGE)
+		charge = MAX_CHARGE;
+}
+
+// brightness is divided by 2^dim, set from the light level while the show runs
+uint8_t dim;
+
+// Hue wheel of HUES colors at full value in flash, computed at compile time with Config::SATURATION
+// and white balance. Each channel is full for 1/3 of the wheel, ramps for 1/3 and is off for 1/3
+// (at full saturation); hue 0 is LED1 (blue), HUES / 3 is LED2 (green) and 2 * HUES / 3 is LED3 (red).
+const uint8_t HUES = 48; // divisible by 3 for primary hues
+
+// first channel level at x = 0..1535 on the wheel (6 sectors of 256), other channels are shifted by 1/3
+constexpr uint8_t hueLevel(uint16_t x) {
+	return x < 256 ? 0xff : x < 512 ? 511 - x : x < 1024 ? 0 : x < 1280 ? x - 1024 : 0xff;
+}
+
+constexpr uint8_t saturate(uint8_t v) {
+	return v + (0xff - v) * (0xff - Config::SATURATION) / 0xff;
+}
+
+constexpr uint8_t balance(uint8_t v, uint8_t c) {
+	return v * (c == 0 ? Config::LED1_SCALE : c == 1 ? Config::LED2_SCALE : Config::LED3_SCALE) / 0xff;
+}
+
+constexpr uint8_t hueChannel(uint8_t h, uint8_t c) {
+	return balance(saturate(hueLevel((h * 1536U / HUES + (3 - c) % 3 * 512U) % 1536U)), c);
+}
+
+#define HUE(h) { hueChannel(h, 0), hueChannel(h, 1), hueChannel(h, 2) }
+#define HUE8(h) HUE(h), HUE(h + 1), HUE(h + 2), HUE(h + 3), HUE(h + 4), HUE(h + 5), HUE(h + 6), HUE(h + 7)
+
+const uint8_t hues[HUES][3] PROGMEM = { HUE8(0), HUE8(8), HUE8(16), HUE8(24), HUE8(32), HUE8(40) };
+
+static_assert(sizeof(hues) == HUES * 3, "hue table size");
+static_assert(hueLevel(0) == 0xff && hueLevel(512) == 0 && hueLevel(1279) == 0xff, "hue wheel");
+
+static_assert((HUES / 3 & (HUES / 3 - 1)) == 0, "HUES / 3 must be a power of 2 for EFFECT_EFFICIENT");
+
+// largest sum of channel levels on the hue wheel, up to 3 x 0xff with lower saturation
+constexpr uint16_t maxHueLevels(uint8_t h = 0, uint16_t max = 0) {
+	return h == HUES ? max : maxHueLevels(h + 1,
+		(uint16_t)(hueChannel(h, 0) + hueChannel(h, 1) + hueChannel(h, 2)) > max ?
+			hueChannel(h, 0) + hueChannel(h, 1) + hueChannel(h, 2) : max);
+}
+
+// charge of the brightest hue cycle
+const uint16_t MAX_CYCLE_UAS = CYCLE_UAS + ((uint32_t)maxHueLevels() * LED_UAS >> 8);
+
+// random hue for the show effect, or primary one for EFFECT_ONE_COLOR by kind = 1..3
+inline uint8_t chooseHue(uint8_t kind) {
+	switch (params.effect) {
+		case EFFECT_ONE_COLOR:
+			return (kind - 1) * (HUES / 3);
+		case EFFECT_EFFICIENT:
+			return HUES / 3 + (random() & (HUES / 3 - 1)); // green, yellow to orange, no blue
+		default:
+			return (uint16_t)random() * HUES >> 8;
+	}
+}
+
+// Scripted pattern for EFFECT_PATTERN, must end dark: a double heartbeat in red, then a green glow.
+// Levels are white balanced as hues are.
+#define PATTERN_LEVEL(level, c) balance(level, c)
+constexpr uint8_t lightPattern[] PROGMEM = {
+	PATTERN_FADE(6, 0, 0, 0, 0, 0, 127), PATTERN_FADE(6, 0, 0, 127, 0, 0, 254),
+	PATTERN_FADE(6, 0, 0, 254, 0, 0, 127), PATTERN_FADE(6, 0, 0, 127, 0, 0, 0),
+	PATTERN_HOLD(64),
+	PATTERN_FADE(5, 0, 0, 0, 0, 0, 100), PATTERN_FADE(6, 0, 0, 100, 0, 0, 0),
+	PATTERN_HOLD(127),
+	PATTERN_FADE(7, 0, 0, 0, 0, 60, 0), PATTERN_FADE(7, 0, 60, 0, 0, 0, 0),
+	PATTERN_END
+};
+
+static_assert(patternLevel(lightPattern, 0) == 0 && patternLevel(lightPattern, 1) == 0 &&
+	patternLevel(lightPattern, 2) == 0, "lightPattern must end dark");
+
+// estimated charge of a pattern cycle, as for ramp cycles (without dimming)
+const uint16_t PATTERN_TICKS = patternTicks(lightPattern);
+const uint16_t PATTERN_UAS = (uint32_t)CYCLE_UAS * PATTERN_TICKS / (2 * Config::RAMP_STEPS) +
+	(uint64_t)patternLevelTicks(lightPattern) * LED_UAS / 256 / Config::RAMP_STEPS;
+
+PatternPlayer pattern;
+
+// Morse codes packed first symbol in the lowest bit (1 is dash) up to a leading 1, 0 is a word gap
+constexpr const char* MORSE_LETTERS[] = {
+	".-", "-...", "-.-.", "-..", ".", "..-.", "--.", "....", "..", ".---", "-.-", ".-..", "--",
+	"-.", "---", ".--.", "--.-", ".-.", "...", "-", "..-", "...-", ".--", "-..-", "-.--", "--.."
+};
+constexpr const char* MORSE_DIGITS[] = {
+	"-----", ".----", "..---", "...--", "....-", ".....", "-....", "--...", "---..", "----."
+};
+
+constexpr uint8_t morsePack(const char* s) {
+	return *s == 0 ? 1 : morsePack(s + 1) << 1 | (*s == '-');
+}
+
+constexpr uint8_t morseCode(char c) {
+	return c >= 'A' && c <= 'Z' ? morsePack(MORSE_LETTERS[c - 'A']) :
+		c >= 'a' && c <= 'z' ? morsePack(MORSE_LETTERS[c - 'a']) :
+		c >= '0' && c <= '9' ? morsePack(MORSE_DIGITS[c - '0']) : 0;
+}
+
+constexpr uint8_t textLength(const char* s) {
+	return *s == 0 ? 0 : 1 + textLength(s + 1);
+}
+
+const uint8_t MESSAGE_MAX = 16;
+const uint8_t MESSAGE_LENGTH = textLength(Config::MESSAGE);
+
+constexpr uint8_t messageCode(uint8_t i) {
+	return i < MESSAGE_LENGTH ? morseCode(Config::MESSAGE[i]) : 0;
+}
+
+#define MORSE4(i) messageCode(i), messageCode(i + 1), messageCode(i + 2), messageCode(i + 3)
+
+const uint8_t message[MESSAGE_MAX] PROGMEM = { MORSE4(0), MORSE4(4), MORSE4(8), MORSE4(12) };
+
+static_assert(MESSAGE_LENGTH > 0 && MESSAGE_LENGTH <= MESSAGE_MAX, "MESSAGE must have 1 to 16 characters");
+static_assert(morseCode('A') == 0x06 && morseCode('0') == 0x3f, "Morse code packing");
+static_assert(Config::MESSAGE_HUE < HUES, "MESSAGE_HUE out of range");
+static_assert((Config::MORSE_FADE_MS & (Config::MORSE_FADE_MS - 1)) == 0 &&
+	2 * Config::MORSE_FADE_MS <= Config::MORSE_UNIT_MS, "MORSE_FADE_MS must be a power of 2 within a dot");
+
+// estimated charge of a Morse symbol with sum of channel levels, as for ramp cycles
+constexpr uint32_t symbolCharge(uint16_t ticks, uint16_t levels) {
+	return (uint32_t)CYCLE_UAS * ticks / (2 * Config::RAMP_STEPS) +
+		(uint64_t)levels * LED_UAS * (ticks - Config::MORSE_FADE_MS) / 256 / Config::RAMP_STEPS;
+}
+
+// up to 5 dashes in a letter
+const uint32_t MESSAGE_UAS = 5 * symbolCharge(3 * Config::MORSE_UNIT_MS,
+	hueChannel(Config::MESSAGE_HUE, 0) + hueChannel(Config::MESSAGE_HUE, 1) + hueChannel(Config::MESSAGE_HUE, 2));
+
+// Morse units of a letter code, each symbol with the gap after it
+constexpr uint16_t letterUnits(uint8_t code) {
+	return code > 1 ? (code & 1 ? 4 : 2) + letterUnits(code >> 1) : 0;
+}
+
+// Morse units of the message from letter i: letters end with a gap of 3 units and a word gap of 7
+// units precedes the first letter and every one after gaps
+constexpr uint16_t messageUnits(uint8_t i = 0) {
+	return i == MESSAGE_LENGTH ? 0 : messageUnits(i + 1) + (messageCode(i) == 0 ? 0 :
+		letterUnits(messageCode(i)) + 2 + (i == 0 || messageCode(i - 1) == 0 ? 4 : 0));
+}
+
+const uint32_t MESSAGE_MS = (uint32_t)messageUnits() * Config::MORSE_UNIT_MS;
+const uint8_t MESSAGE_REPEATS_MAX = 0xff / MESSAGE_LENGTH;
+
+static_assert(MESSAGE_MS > 0, "MESSAGE must have a letter or digit");
+
+// brightness of a lit cycle is divided by 2^cycleShift()
+inline uint8_t cycleShift() {
+	uint8_t shift = dim + params.dim;
+	if (charge < MAX_CHARGE / 4)
+		shift++; // dimmer when budget is running low
+	return shift;
+}
+
+// charge a lit cycle needs from energy budget
+inline uint32_t cycleCharge() {
+	return params.effect == EFFECT_PATTERN ? PATTERN_UAS : params.effect == EFFECT_MESSAGE ? MESSAGE_UAS : MAX_CYCLE_UAS;
+}
+
+inline void debitCycle(uint32_t uas) {
+	charge = charge > uas ? charge - uas : 0; // budget does not wrap when an estimate falls short
+	countCharge(uas);
+	if (Config::STATS)
+		stats.cycles++;
+}
+
+// chooses hue of 500ms lit cycle for kind = 1..3, returns ramp value increments
+inline void startHue(uint8_t kind, uint16_t& d1, uint16_t& d2, uint16_t& d3) {
+	uint8_t h = chooseHue(kind);
+	uint8_t p1 = pgm_read_byte(&hues[h][0]);
+	uint8_t p2 = pgm_read_byte(&hues[h][1]);
+	uint8_t p3 = pgm_read_byte(&hues[h][2]);
+	uint8_t shift = cycleShift();
+	p1 >>= shift;
+	p2 >>= shift;
+	p3 >>= shift;
+	debitCycle(CYCLE_UAS + ((uint32_t)(p1 + p2 + p3) * LED_UAS >> 8));
+	d1 = p1 * RAMP_INC;
+	d2 = p2 * RAMP_INC;
+	d3 = p3 * RAMP_INC;
+}
+
+// starts timers of a lit cycle
+void startCycle() {
+	// reset if timer interrupts stop coming (interrupt on first timeout, reset on second)
+	Watchdog::guard(WDTO_60MS);
 	// power on timers
-	PRR &= ~(_BV(PRTIM1) | _BV(PRTIM0));
+	Power::on(Timer1::PRR_MASK | Timer0::PRR_MASK);
+	// off compare values, written before PWM mode so they are not buffered
+	Timer0::compareA(0xff);
+	Timer0::compareB(0xff);
+	Timer1::compareB(0xff);
+	if (Config::TIMER1_PLL)
+		Timer1::pllStart(); // locked before timers run
 	// turn on and configure timers
-	TCCR0A = _BV(WGM01) | _BV(WGM00); // clear on match, set on top
-	TCCR0B = _BV(CS00); // run, no prescaler; @1MHz clock, PWM Freq ~= 4 KHz
-	GTCCR = _BV(COM1B1); // clear on match, set on top
-	TCCR1 = _BV(CS10); // run, no prescaler; @1MHz clock, PWM Freq ~= 4 KHz
-	// configure PWM for non-zero outputs
-	if (p1 != 0)
-		TCCR0A |= _BV(COM0A1); // PWM on OCR0A
-	if (p2 != 0)
-		TCCR0A |= _BV(COM0B1); // PWM on OCR0B
-	if (p3 != 0)	
-		GTCCR |= _BV(PWM1B); // PWM on OCR1B
+	Timer0::pwm(); // fast PWM
+	Timer0::start(); // @1MHz clock, PWM Freq ~= 4 KHz
+	Timer1::pwmB(); // PWM on OCR1B
+	Timer1::start(); // @1MHz clock, PWM Freq ~= 4 KHz; from PLL ~= 125 KHz
 	// reset timers
-	TCNT0 = 0;
-	TCNT1 = 0;
-	TIMSK |= _BV(TOIE0); // enable timer0 overflow interrupt
-	TIFR |= _BV(TOV0); // reset timer0 overflow flag
-	set_sleep_mode(SLEEP_MODE_IDLE); // idle sleep with timers running
-	// do the actual animation
-	uint16_t s1 = 0;
-	uint16_t s2 = 0;
-	uint16_t s3 = 0;
-	uint8_t i = 0;
-	// ramp up 256 x 1ms
-	do {
-		s1 += p1;
-		s2 += p2;
-		s3 += p3;
-		OCR0A = s1 >> 8;
-		OCR0B = s2 >> 8;
-		OCR1B = s3 >> 8;	
-		waitTimer();
-	} while (++i != 0);
-	// ramp down 256 x 1ms 
-	do {
-		s1 -= p1;
-		s2 -= p2;
-		s3 -= p3;
-		OCR0A = s1 >> 8;
-		OCR0B = s2 >> 8;
-		OCR1B = s3 >> 8;
-		waitTimer();
-	} while (++i != 0);
-	// done animation
-	set_sleep_mode(SLEEP_MODE_PWR_DOWN); // back to power down sleep
-	TIMSK &= ~_BV(TOIE0); // disable timer0 overflow interrupt
+	Timer0::reset();
+	Timer1::reset();
+	Timer0::enableOverflow();
+	tickEnd = tcnt0h;
+	Sleep::idle(); // idle sleep with timers running
+}
+
+void stopCycle() {
+	disableInterrupts(); // enabled between ticks only
+	Watchdog::disable(); // disarm reset, watchdog sleeps between cycles set their own timeout
+	Sleep::powerDown(); // back to power down sleep
+	Timer0::disableOverflow();
 	// turn off timers
-	TCCR0A = 0;
-	TCCR0B = 0;
-	GTCCR = 0;
-	TCCR1 = 0;
+	Timer0::stop();
+	Timer1::stop();
+	if (Config::TIMER1_PLL)
+		Timer1::pllStop();
 	// power off timers
-	PRR |= _BV(PRTIM1) | _BV(PRTIM0);
+	Power::off(Timer1::PRR_MASK | Timer0::PRR_MASK);
 }
 
-// 2 min = 240 x 0.5s
-inline void animateLoop() {
-	for (uint8_t i = 0; i < 240; i++) {
-		animateOne();
-		if (night())
-			return;
+// Scheduler: the day and night loop, show effect and light sensing are protothread tasks, run on
+// every wake up and again while one of them notifies a change of shared state.
+
+// Timer service: the only place the CPU sleeps. Task deadlines in ms are kept in a queue sorted
+// by time from now and the CPU sleeps until the first one, so every wake up has work to do:
+//  - while a lit cycle runs, Timer0 PWM overflows give a tick of 1024 clocks (every 4 periods,
+//    waking up for dithering)
+//  - watchdog timeouts (16ms << wdto) and longer waits are slept in power-down with the watchdog,
+//    longer ones with the longest timeout that fits
+//  - other waits within Timer0 range are slept in idle with Timer0 compare ticks of 1024 clocks
+// The clock is advanced by the time each sleep took, ticks are scaled by F_CPU with the fraction
+// kept in 1/125 ms. Light sensing only ends on watchdog timeouts, so no sleep ends early.
+
+enum TaskId : uint8_t {
+	TASK_MAIN,
+	TASK_EFFECT,
+	TASK_SENSE,
+	TASKS
+};
+
+struct Task {
+	Pt pt;
+	uint16_t until; // deadline in ms while queued
+};
+
+Task tasks[TASKS];
+uint8_t queue[TASKS]; // ids of tasks waiting for deadlines, nearest first
+uint8_t queued;
+uint16_t now; // ms
+uint8_t nowFraction; // 1/125 ms
+uint16_t periodStart; // of current polling period
+uint16_t periods; // polling periods elapsed
+bool notified; // shared state has changed, tasks run again before sleeping
+
+// Timer0 tick of 1024 clocks in 1/125 ms, and the longest Timer0 sleep of 255 ticks in ms
+const uint16_t TICK_FRACTIONS = 1024 * 125000ULL / F_CPU;
+const uint16_t TICKS_MAX_MS = 255UL * TICK_FRACTIONS / 125;
+
+static_assert(1024 * 125000ULL % F_CPU == 0 && TICKS_MAX_MS >= 16, "F_CPU must be 1, 2, 4, 8 or 16MHz");
+
+inline bool reached(uint16_t t) {
+	return (int16_t)(now - t) >= 0;
+}
+
+void cancelTimer(uint8_t id) {
+	uint8_t j = 0;
+	for (uint8_t i = 0; i < queued; i++)
+		if (queue[i] != id)
+			queue[j++] = queue[i];
+	queued = j;
+}
+
+// queues deadline of task id in ms from now
+void setTimer(uint8_t id, uint16_t ms) {
+	uint16_t until = now + ms;
+	tasks[id].until = until;
+	uint8_t i = queued++;
+	for (; i > 0 && (uint16_t)(tasks[queue[i - 1]].until - now) > ms; i--)
+		queue[i] = queue[i - 1];
+	queue[i] = id;
+}
+
+// waits until condition or ms from now
+#define TASK_WAIT(id, ms, cond) do { \
+	setTimer(id, ms); \
+	PT_WAIT_UNTIL(tasks[id].pt, (cond) || reached(tasks[id].until)); \
+	cancelTimer(id); \
+} while (0)
+#define TASK_SLEEP(id, ms) TASK_WAIT(id, ms, false)
+
+// advances clock by ms, crediting energy budget every polling period
+void advanceMs(uint16_t ms) {
+	now += ms;
+	while ((uint16_t)(now - periodStart) >= PERIOD_MS) {
+		periodStart += PERIOD_MS;
+		periods++;
+		creditPeriod();
+	}
+}
+
+// advances clock by n ticks of 1024 clocks
+void advanceTicks(uint8_t n) {
+	uint16_t fraction = nowFraction + n * TICK_FRACTIONS;
+	uint16_t ms = 0;
+	for (; fraction >= 125; fraction -= 125)
+		ms++;
+	nowFraction = fraction;
+	advanceMs(ms);
+}
+
+// sleeps in power-down for the watchdog timeout
+void sleepWatchdog(uint8_t wdto) {
+	wdSleep(wdto);
+	advanceMs(16U << wdto);
+}
+
+// sleeps in idle for n Timer0 ticks
+void sleepTicks(uint8_t n) {
+	Power::on(Timer0::PRR_MASK);
+	Timer0::startTicks(n);
+	Sleep::idle();
+	Sleep::wait();
+	Sleep::powerDown();
+	n = Timer0::count();
+	Timer0::stopTicks();
+	Power::off(Timer0::PRR_MASK);
+	advanceTicks(n);
+}
+
+// Show state shared by tasks
+struct Show {
+	bool playing;
+	bool stop; // stop condition for night state
+	bool stopped; // by light or energy budget
+	bool pwm; // lit cycle is running
+	uint8_t cycle;
+	uint8_t cycles; // show length
+	uint8_t unsensed;
+	uint8_t kind;
+	uint8_t shift; // of pattern levels
+	uint8_t letter; // of message
+	bool wordGap; // due before the next letter
+	uint8_t code; // Morse symbols left in the letter
+	uint16_t step;
+	uint16_t ticks; // of Morse symbol
+	uint16_t s1, s2, s3; // 8.8 fixed point channel values
+	uint16_t d1, d2, d3; // ramp increments
+};
+
+Show show;
+
+// Light sensing request: level is the number of doubling watchdog waits from wdto the LED has
+// not discharged in, up to levels
+struct Light {
+	bool sensing;
+	uint8_t wdto;
+	uint8_t levels;
+	uint8_t level;
+};
+
+Light light;
+
+// senses light in task id, the result is in light.level
+#define TASK_SENSE_LIGHT(id, first, n) do { \
+	light.wdto = first; \
+	light.levels = n; \
+	light.sensing = true; \
+	notified = true; \
+	PT_WAIT_UNTIL(tasks[id].pt, !light.sensing); \
+} while (0)
+
+// Night state of the main loop
+struct Night {
+	uint16_t start; // periods at dusk
+	bool whole; // day was seen before, the first night after reset may have begun earlier
+	bool preDawn; // pre-dawn show has played
+	bool dark; // resumed in a night show, the main loop continues in the night
+	uint8_t polls; // of light gesture
+	uint8_t flashes;
+	bool lit;
+};
+
+Night night;
+
+// one ramp step up or down on all channels
+inline void rampStep(bool up) {
+	uint16_t s1 = show.s1;
+	uint16_t s2 = show.s2;
+	uint16_t s3 = show.s3;
+	if (up) {
+		s1 += show.d1;
+		s2 += show.d2;
+		s3 += show.d3;
+	} else {
+		s1 -= show.d1;
+		s2 -= show.d2;
+		s3 -= show.d3;
+	}
+	show.s1 = s1;
+	show.s2 = s2;
+	show.s3 = s3;
+}
+
+// starts lit Morse symbol of units long in Config::MESSAGE_HUE
+inline void startSymbol(uint8_t units) {
+	uint8_t shift = cycleShift();
+	uint8_t p1 = hueChannel(Config::MESSAGE_HUE, 0) >> shift;
+	uint8_t p2 = hueChannel(Config::MESSAGE_HUE, 1) >> shift;
+	uint8_t p3 = hueChannel(Config::MESSAGE_HUE, 2) >> shift;
+	show.ticks = units * Config::MORSE_UNIT_MS;
+	debitCycle(symbolCharge(show.ticks, p1 + p2 + p3));
+	show.d1 = p1 * (256 / Config::MORSE_FADE_MS);
+	show.d2 = p2 * (256 / Config::MORSE_FADE_MS);
+	show.d3 = p3 * (256 / Config::MORSE_FADE_MS);
+	startCycle();
+	show.pwm = true;
+}
+
+// 2 min = 240 x 0.5s by default, light is sensed at start, during idle cycles and at least every SENSE_CYCLES cycles
+void effectTask() {
+	Pt& pt = tasks[TASK_EFFECT].pt;
+	PT_BEGIN(pt);
+	for (;;) {
+		PT_WAIT_UNTIL(pt, show.playing);
+		for (; show.cycle < show.cycles; show.cycle++) {
+			resume.cycle = show.cycle;
+			show.kind = params.effect == EFFECT_MESSAGE ? 1 : random() & 3; // message has a letter in every cycle
+			trace(TRACE_CYCLE | show.kind);
+			if (show.kind == 0 || ++show.unsensed == Config::SENSE_CYCLES) {
+				show.unsensed = 0;
+				TASK_SENSE_LIGHT(TASK_EFFECT, WDTO_15MS, Config::NIGHT_LEVEL);
+				if ((light.level >= Config::NIGHT_LEVEL) == show.stop) {
+					show.stopped = true; // night state has become the stop condition
+					break;
+				}
+				// full brightness in daylight down to 1/4 at night, dusk levels spread over the range
+				dim = (2 * light.level + Config::NIGHT_LEVEL - 1) / Config::NIGHT_LEVEL;
+			}
+			if (show.kind == 0) {
+				TASK_SLEEP(TASK_EFFECT, 16U << Config::IDLE_WDTO); // rest of idle cycle, sensing already took part of it
+			} else if (charge < cycleCharge()) {
+				count(stats.budgetStops);
+				show.stopped = true; // energy budget is spent, trim the show
+				break;
+			} else if (params.effect == EFFECT_MESSAGE) {
+				show.code = pgm_read_byte(&message[show.letter]);
+				if (show.code == 0)
+					show.wordGap = true; // gaps in a row are one
+				else if (show.wordGap) {
+					show.wordGap = false;
+					TASK_SLEEP(TASK_EFFECT, 4 * Config::MORSE_UNIT_MS); // word gap is 7 units with the letter gap
+				}
+				for (; show.code > 1; show.code >>= 1) {
+					startSymbol(show.code & 1 ? 3 : 1);
+					// fade in, hold and fade out
+					for (show.step = 0; show.step < show.ticks; show.step++) {
+						if (show.step < Config::MORSE_FADE_MS)
+							rampStep(true);
+						else if (show.step >= show.ticks - Config::MORSE_FADE_MS)
+							rampStep(false);
+						TASK_SLEEP(TASK_EFFECT, 1);
+					}
+					show.pwm = false;
+					stopCycle();
+					TASK_SLEEP(TASK_EFFECT, Config::MORSE_UNIT_MS); // gap between symbols
+				}
+				if (show.code != 0)
+					TASK_SLEEP(TASK_EFFECT, 2 * Config::MORSE_UNIT_MS); // rest of gap after a letter
+				if (++show.letter == MESSAGE_LENGTH) {
+					show.letter = 0;
+					show.wordGap = true; // before repeating
+				}
+			} else {
+				if (params.effect == EFFECT_PATTERN) {
+					debitCycle(PATTERN_UAS);
+					show.shift = cycleShift();
+					pattern.start(lightPattern);
+				} else
+					startHue(show.kind, show.d1, show.d2, show.d3);
+				startCycle();
+				show.pwm = true;
+				if (params.effect == EFFECT_PATTERN) {
+					// one pattern frame per tick, ends dark
+					while (pattern.tick()) {
+						show.s1 = pattern.s1 >> show.shift;
+						show.s2 = pattern.s2 >> show.shift;
+						show.s3 = pattern.s3 >> show.shift;
+						TASK_SLEEP(TASK_EFFECT, 1);
+					}
+				} else {
+					// ramp up and down RAMP_STEPS ticks
+					for (show.step = 0; show.step < 2 * Config::RAMP_STEPS; show.step++) {
+						rampStep(show.step < Config::RAMP_STEPS);
+						TASK_SLEEP(TASK_EFFECT, 1);
+					}
+				}
+				show.pwm = false;
+				stopCycle();
+			}
+		}
+		if (!show.stopped)
+			count(stats.fullShows);
+		resume.magic = 0;
+		show.playing = false;
+		notified = true;
+	}
+	PT_END(pt);
+}
+
+// senses light when requested with doubling watchdog waits, discharge is checked at their end
+void senseTask() {
+	Pt& pt = tasks[TASK_SENSE].pt;
+	PT_BEGIN(pt);
+	for (;;) {
+		PT_WAIT_UNTIL(pt, light.sensing);
+		startSensing();
+		light.level = 0;
+		do {
+			TASK_SLEEP(TASK_SENSE, 16U << light.wdto++);
+		} while (charged() && ++light.level < light.levels);
+		stopSensing(light.level);
+		light.sensing = false;
+		notified = true;
+	}
+	PT_END(pt);
+}
+
+// starts show from cycle from that can be resumed after watchdog reset
+void startShow(ShowStart start, uint8_t from) {
+	trace(TRACE_SHOW | start);
+	if (from == 0)
+		count(stats.shows);
+	resume.start = start;
+	resume.night = periods - night.start;
+	resume.magic = RESUME_MAGIC;
+	show = Show();
+	show.playing = true;
+	show.stop = start < SHOW_PRE_DAWN;
+	show.cycle = from;
+	show.cycles = params.showCycles;
+	if (params.effect == EFFECT_MESSAGE) {
+		// whole messages for about the time of the show
+		uint32_t repeats = (uint32_t)params.showCycles * CYCLE_MS / MESSAGE_MS;
+		show.cycles = (repeats == 0 ? 1 : repeats < MESSAGE_REPEATS_MAX ? repeats : MESSAGE_REPEATS_MAX) * MESSAGE_LENGTH;
+		show.letter = from % MESSAGE_LENGTH;
+	}
+	show.unsensed = Config::SENSE_CYCLES - 1;
+	notified = true;
+}
+
+// plays show in task id
+#define TASK_SHOW(id, start, from) do { \
+	startShow(start, from); \
+	PT_WAIT_UNTIL(tasks[id].pt, !show.playing); \
+} while (0)
+
+// Day and night loop polling light every polling period, after the show at boot or the one resumed
+// after watchdog reset. Light seen at night is polled every ~750ms up to GESTURE_POLLS times and a
+// show runs when it flashes twice (on, off, on, off); dawn when it stays on.
+void mainTask() {
+	Pt& pt = tasks[TASK_MAIN].pt;
+	PT_BEGIN(pt);
+	if (Config::CONFIG_WIRE && wireConfig()) {
+		// acknowledge with LED1 blink
+		Pin<Config::LED1_BIT>::high();
+		TASK_SLEEP(TASK_MAIN, 16U << WDTO_250MS);
+		Pin<Config::LED1_BIT>::low();
+	}
+	loadParams();
+	if (resume.magic == RESUME_MAGIC) {
+		// a night show continues the night where it hung, time lost in reset keeps it from learning
+		night.whole = false;
+		night.dark = resume.start >= SHOW_PRE_DAWN;
+		night.start = periods - resume.night;
+		night.preDawn = resume.night + PRE_DAWN_PERIODS >= nightLength;
+		TASK_SHOW(TASK_MAIN, resume.start, resume.cycle + 1); // skip the cycle that hung
+	} else
+		TASK_SHOW(TASK_MAIN, SHOW_BOOT, 0);
+	for (;;) {
+		if (!night.dark) {
+			// sleep while day continues
+			for (;;) {
+				TASK_SLEEP(TASK_MAIN, PERIOD_MS);
+				TASK_SENSE_LIGHT(TASK_MAIN, Config::NIGHT_WDTO, 1);
+				if (light.level != 0)
+					break;
+				night.whole = true;
+			}
+			night.start = periods;
+			night.preDawn = false;
+		}
+		// sleep while night, its length is counted by the clock including shows and gestures
+		night.dark = false;
+		for (;;) {
+			TASK_SLEEP(TASK_MAIN, PERIOD_MS);
+			if (PRE_DAWN_PERIODS != 0 && nightLength != 0 && !night.preDawn &&
+					(uint16_t)(periods - night.start) + PRE_DAWN_PERIODS >= nightLength) {
+				night.preDawn = true;
+				TASK_SHOW(TASK_MAIN, SHOW_PRE_DAWN, 0); // stops early if dawn comes sooner
+			}
+			TASK_SENSE_LIGHT(TASK_MAIN, Config::NIGHT_WDTO, 1);
+			if (light.level != 0)
+				continue;
+			night.flashes = 1; // light is on now
+			night.lit = true;
+			for (night.polls = 0; night.polls < Config::GESTURE_POLLS; night.polls++) {
+				TASK_SLEEP(TASK_MAIN, 16U << Config::GESTURE_WDTO);
+				TASK_SENSE_LIGHT(TASK_MAIN, Config::NIGHT_WDTO, 1);
+				if (night.lit == (light.level != 0)) { // changed
+					night.lit = !night.lit;
+					if (night.lit)
+						night.flashes++;
+					else if (night.flashes == 2) {
+						TASK_SHOW(TASK_MAIN, SHOW_GESTURE, 0); // show on demand, stops early if dawn comes
+						break;
+					}
+				}
+			}
+			if (night.lit)
+				break; // dawn
+			if (night.polls == Config::GESTURE_POLLS)
+				count(stats.lightFlips);
+		}
+		if (night.whole)
+			learnNight(periods - night.start);
+		count(stats.nights);
+		if (Config::STATS)
+			flushStats(); // once a day at dawn, before the show
+		TASK_SHOW(TASK_MAIN, SHOW_DAWN, 0);
 	}
+	PT_END(pt);
+}
+
+// sleeps until the next lit cycle tick or task deadline
+void sleepUntilNext() {
+	if (show.pwm) {
+		outputTick(show.s1, show.s2, show.s3);
+		advanceTicks(1);
+		return;
+	}
+	uint16_t wait = tasks[queue[0]].until - now; // main task waits for a deadline or for the tasks that do
+	uint8_t wdto = WDTO_15MS;
+	while (wdto < WDTO_8S && (32U << wdto) <= wait)
+		wdto++;
+	if (wait > TICKS_MAX_MS || (16U << wdto) == wait)
+		sleepWatchdog(wdto);
+	else
+		sleepTicks((125U * wait - nowFraction + TICK_FRACTIONS - 1) / TICK_FRACTIONS);
+}
+
+// runs tasks until none of them notifies a change, then sleeps
+void schedule() {
+	do {
+		notified = false;
+		mainTask();
+		effectTask();
+		senseTask();
+	} while (notified);
+	sleepUntilNext();
 }
 
 int main(void) {
 	// ----------------- setup -----------------
-	PRR = _BV(PRTIM1) | _BV(PRTIM0) | _BV(PRUSI) | _BV(PRADC); // turn off Time1, Timer0, USI & ADC
-	ACSR = _BV(ACD); // turn off Analog Comparator
-	DDRB = _BV(LED0_BIT) | _BV(LED1_BIT) | _BV(LED2_BIT) | _BV(LED3_BIT); // All LED pins are output
-	PORTB = 0xff & ~(_BV(LED0_BIT) | _BV(LED1_BIT) | _BV(LED2_BIT) | _BV(LED3_BIT)); // pull up all other pins to ensure defined level and save power
-	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
-	sleep_enable();
+	bool resuming = Watchdog::wasReset() && resume.magic == RESUME_MAGIC;
+	Watchdog::disable(); // stays enabled after watchdog reset
+	if (!resuming) {
+		resume.magic = 0;
+		seedRandom();
+		charge = MAX_CHARGE;
+	}
+	Prr::write(Timer1::PRR_MASK | Timer0::PRR_MASK | Power::UNUSED); // turn off Time1, Timer0, USI & ADC
+	Comparator::off();
+	DdrB::write(TRACE ? LED_BITS | _BV(PB3) : LED_BITS); // All LED pins (and trace) are output
+	PortB::write(0xff & ~LED_BITS); // pull up all other pins to ensure defined level and save power, trace idles high
+	Sleep::powerDown();
+	Sleep::enable();
+	nightLength = eeprom_read_word(&eeprom.nightLength);
+	if (nightLength > MAX_NIGHT_PERIODS)
+		nightLength = 0; // erased EEPROM
+	if (Config::STATS)
+		loadStats();
+	if (resuming) {
+		count(stats.resets);
+		count(stats.shows); // started after the last flush, its count was lost with RAM
+	}
 	// ----------------- loop -----------------
-    while (true) {
-		animateLoop();
-		// sleep while day continues
-		do {
-			wdSleep(WDTO_8S);
-		} while (!night());
-		// sleep while night
-		do {
-			wdSleep(WDTO_8S);
-		} while (night());
-    }
-}
\ No newline at end of file
+	while (true)
+		schedule();
+}
@@ -0,0 +1,5 @@
+// Test configuration: white balance dimming green, the brightest channel, and a little red
+struct BalancedConfig : DefaultConfig {
+	static constexpr uint8_t LED2_SCALE = 0x60;
+	static constexpr uint8_t LED3_SCALE = 0xc0;
+};
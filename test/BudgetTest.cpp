@@ -0,0 +1,40 @@
+// Energy budget estimates with pale colors: the brightest hue bounds a cycle, debits do not wrap and
+// the charge counted in the statistics tracks the harness model of LED, idle and sleep current
+
+#include "Host.h"
+
+int main() {
+	hostSetup();
+
+	uint16_t max = 0;
+	for (uint8_t h = 0; h < HUES; h++) {
+		uint16_t sum = pgm_read_byte(&hues[h][0]) + pgm_read_byte(&hues[h][1]) + pgm_read_byte(&hues[h][2]);
+		if (sum > max)
+			max = sum;
+	}
+	CHECK(max > 2 * 0xff); // more than two channels at full
+	CHECK(MAX_CYCLE_UAS == CYCLE_UAS + ((uint32_t)max * LED_UAS >> 8));
+
+	// a lit cycle never debits more than the budget checked for it
+	for (uint16_t i = 0; i < 1000; i++) {
+		uint32_t used = stats.usedUAs;
+		uint16_t d1, d2, d3;
+		startHue(1 + i % 3, d1, d2, d3);
+		CHECK(stats.usedUAs - used <= MAX_CYCLE_UAS);
+	}
+
+	charge = 10;
+	debitCycle(100);
+	CHECK(charge == 0);
+
+	// 10 days of shows at dawn and pre-dawn
+	hostChargeReset();
+	hostLight = hostDaylight;
+	hostRun(10 * 24 * HOST_HOUR_MS);
+	CHECK(stats.nights == 10 && stats.shows == 1 + 10 + 9);
+	double model = hostChargeUAs();
+	printf("charge used: %.1f uAh, firmware estimate %.1f uAh\n", model / 3600, stats.usedUAs / 3600.0);
+	CHECK(stats.usedUAs > model * 0.98 && stats.usedUAs < model * 1.02);
+
+	return hostFailures != 0;
+}
@@ -0,0 +1,62 @@
+// Pattern encoder: reproduces lightPattern from its CSV, decoded frames follow the keyframe ramps
+
+#include "Host.h"
+#include "../tools/PatternEncoder.h"
+
+PatternKey keys[64];
+PatternRecord records[256];
+uint8_t bytes[256 * PATTERN_RAMP_SIZE + 1];
+
+// encodes CSV text into bytes, returns their size or 0
+uint16_t encode(const char* csv, int& count) {
+	int line;
+	count = parsePatternCsv(csv, keys, 64, line);
+	if (count < 0)
+		return 0;
+	int n = encodePattern(keys, count, records, 256);
+	return n < 0 ? 0 : patternBytes(records, n, bytes);
+}
+
+int main() {
+	// lightPattern with default white balance is its CSV source
+	static char csv[4096];
+	FILE* f = fopen(PATTERN_CSV, "r");
+	CHECK(f != nullptr);
+	csv[fread(csv, 1, sizeof(csv) - 1, f)] = 0;
+	fclose(f);
+	int count;
+	CHECK(encode(csv, count) == sizeof(lightPattern));
+	CHECK(memcmp(bytes, lightPattern, sizeof(lightPattern)) == 0);
+
+	// ramps of any length, long holds and a steep one tick change, levels within 1 of the linear ramps
+	uint16_t size = encode("# test\n300,255,10,0\n\n200,255,10,0\n1,128,10,0\n77,0,0,200\n 9, 0, 0, 0\n", count);
+	CHECK(size != 0 && count == 5);
+	PatternPlayer player;
+	player.start(bytes);
+	uint32_t ticks = 0;
+	uint8_t from[3] = {};
+	for (int k = 0; k < count; k++) {
+		for (uint16_t t = 1; t <= keys[k].ticks; t++, ticks++) {
+			CHECK(player.tick());
+			uint16_t s[3] = { player.s1, player.s2, player.s3 };
+			for (uint8_t c = 0; c < 3; c++) {
+				int expected = patternLevelAt(from[c], keys[k].levels[c], t, keys[k].ticks);
+				int level = (s[c] + 0x80) >> 8;
+				CHECK(level >= expected - 1 && level <= expected + 1);
+			}
+		}
+		memcpy(from, keys[k].levels, 3);
+	}
+	CHECK(!player.tick());
+	CHECK(player.s1 == 0 && player.s2 == 0 && player.s3 == 0);
+	printf("%u ticks in %u bytes, %.1f:1 to raw frames\n", (unsigned)ticks, size, 3.0 * ticks / size);
+
+	// errors
+	int line;
+	CHECK(parsePatternCsv("10,0,0,0\n10,0,256,0\n", keys, 64, line) < 0 && line == 2);
+	CHECK(parsePatternCsv("0,0,0,0\n", keys, 64, line) < 0 && line == 1);
+	CHECK(encode("10,0,0,10\n", count) == 0); // does not end dark
+	CHECK(encode("1,0,0,200\n10,0,0,0\n", count) == 0); // too steep
+
+	return hostFailures != 0;
+}
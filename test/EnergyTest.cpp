@@ -0,0 +1,60 @@
+// Charge used over nights under several light profiles: the harness model of LED, idle and sleep
+// current against the firmware's own estimate; dimmer twilight shows use less, a lit night none
+
+#include "Host.h"
+
+const uint16_t DAYS = 3;
+
+// discharge times in ms, twilight is the hour after dawn and the hour before dusk at 6:00 and 18:00
+struct Profile {
+	const char* name;
+	uint32_t day;
+	uint32_t twilight;
+	uint32_t night;
+};
+
+const Profile PROFILES[] = {
+	{ "clear", 1, 1, HOST_DARK },
+	{ "twilight", 1, 50, HOST_DARK },
+	{ "overcast", 40, 120, HOST_DARK },
+	{ "lamplit", 1, 50, 200 }, // never night, the boot show only
+};
+const Profile* profile;
+
+uint32_t profileLight(uint64_t ms) {
+	uint64_t day = (ms + 12 * HOST_HOUR_MS) % (24 * HOST_HOUR_MS); // starts at noon
+	if (day < 6 * HOST_HOUR_MS || day >= 18 * HOST_HOUR_MS)
+		return profile->night;
+	return day < 7 * HOST_HOUR_MS || day >= 17 * HOST_HOUR_MS ? profile->twilight : profile->day;
+}
+
+// runs a new device for DAYS, returns the modeled charge in uAh
+double run(const Profile& p) {
+	profile = &p;
+	memset((void*)&eeprom, 0xff, sizeof(eeprom));
+	hostChargeReset();
+	hostLight = profileLight;
+	hostRun(DAYS * 24 * HOST_HOUR_MS);
+	double model = hostChargeUAs() / 3600;
+	double estimate = stats.usedUAs / 3600.0;
+	printf("%-9s %5.1f uAh, firmware estimate %5.1f uAh, %u shows, %u lit cycles\n", p.name, model, estimate,
+		stats.shows, (unsigned)stats.cycles);
+	CHECK(hostResets == 0);
+	CHECK(stats.nights == (p.night == HOST_DARK ? DAYS : 0));
+	CHECK(estimate > model * 0.97 && estimate < model * 1.03);
+	return model;
+}
+
+int main() {
+	double used[sizeof(PROFILES) / sizeof(PROFILES[0])];
+	for (uint8_t i = 0; i < sizeof(PROFILES) / sizeof(PROFILES[0]); i++)
+		used[i] = run(PROFILES[i]);
+	// shows at dawn are dimmed by the twilight level, sleep is the floor
+	CHECK(used[1] < used[0]);
+	CHECK(used[2] < used[1]);
+	CHECK(used[3] < used[2]);
+	double sleep = DAYS * 24 * 3600.0 * Config::SLEEP_UA / 3600;
+	for (double u : used)
+		CHECK(u > sleep);
+	return hostFailures != 0;
+}
@@ -0,0 +1,33 @@
+// Watchdog reset on a hang in a lit cycle: the show resumes and the night goes on from where it was
+
+#include "Host.h"
+
+uint8_t resumed = 0xff; // show started after the reset
+
+// Timer0 stalls in cycle 10 of the gesture show
+void hang(const uint16_t*) {
+	if (hostResets == 0 && resume.start == SHOW_GESTURE && resume.cycle == 10)
+		hostT0Stalled = true;
+	if (hostResets == 1 && resumed == 0xff)
+		resumed = resume.start;
+}
+
+int main() {
+	hostDay.flashDay = 1; // starts at noon, flashes on the second night at 22:00
+	hostLight = hostDaylight;
+	hostPeriod = hang;
+	hostRun(3 * 24 * HOST_HOUR_MS);
+	CHECK(hostResets == 1);
+	CHECK(resumed == SHOW_GESTURE);
+	CHECK(stats.nights == 3);
+	// the resumed night is not learned, it would shorten nightLength by an hour
+	const uint16_t NIGHT_PERIODS = 12 * HOST_HOUR_MS / PERIOD_MS;
+	CHECK(nightLength + 1 >= NIGHT_PERIODS && nightLength <= NIGHT_PERIODS + 2);
+	// stats are flushed at dawn before the show, the reset reloads them and counts the resumed gesture show
+	// again: at boot, at every dawn after the first, pre-dawn on the resumed night and the next one
+	CHECK(stats.shows == 1 + 2 + 2 + 1);
+	CHECK(stats.fullShows == stats.shows); // the resumed show played to the end
+	CHECK(stats.lightFlips == 0);
+	CHECK(stats.resets == 1);
+	return hostFailures != 0;
+}
@@ -0,0 +1,512 @@
+/*
+  Host test harness: compiles the firmware with HAL_HOST and runs it against a model of the
+  ATtiny85 parts it uses, in simulated time:
+    - sleep ends with the nearest enabled interrupt: watchdog, Timer0 overflow or compare A
+      (idle sleep only, timers are stopped in power-down)
+    - Timer0 overflows in busy waits call the interrupt with interrupts enabled, otherwise one
+      is left pending and ends the next sleep at once
+    - watchdog interrupt and reset modes, a reset restarts main() with RAM initialized again
+      except .noinit, and EEPROM kept
+    - hostT0Stalled stops Timer0 until reset, a hang in a lit cycle
+    - fast PWM compare values are latched at BOTTOM and LED on time is counted per PWM period,
+      a timer started since the last sleep latches them at the sleep
+    - LED junction discharges hostLight(ms) ms after it is charged (seen at the busy wait charging
+      the cathode or at the next sleep), HOST_DARK is never; a cathode driven high for less than
+      HOST_CHARGE_US is not charged and reads as discharged at once
+    - hostChargeUAs() is the charge drawn with the firmware's current estimates: LED on time at
+      Config::LED_UA, idle sleep and busy waits at IDLE_UA, the PLL at PLL_UA and power-down at
+      SLEEP_UA
+    - the PLL locks in a busy wait after it is enabled
+    - hostPins drives input pins from outside (e.g. a programmer on PB3) and watches outputs
+    - with TRACE, a 9600 baud 8N1 receiver on the PB3 pin passes each byte to hostTraced
+  Shared fixtures: hostDaylight, a day and night script for hostLight set up by hostDay, and
+  hostPlayShow, a show played without the main task.
+  Each test program includes it once. Test configurations are passed with -DCONFIG_H as for
+  enclosure variants. Firmware code runs in zero time, so timing is sleep time only.
+*/
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HAL_HOST
+#define main firmwareMain
+#include "../Tiny_RGB_Blinker.cpp"
+#undef main
+
+HAL_HOST_REGISTERS
+
+const uint32_t HOST_CLOCKS_PER_MS = F_CPU / 1000;
+const uint32_t HOST_DARK = 0xffffffff;
+const uint64_t HOST_HOUR_MS = 3600000;
+const double HOST_CHARGE_US = 1; // reverse charge of the LED capacitance through the pin
+
+enum HostWake : uint8_t { HOST_WDT, HOST_TIMER, HOST_PWM, HOST_WAKES }; // HOST_PWM is Timer0 in fast PWM
+enum HostExit { HOST_LIMIT = 1, HOST_RESET, HOST_STUCK };
+
+uint64_t hostClock; // simulated time in CPU clocks
+uint64_t hostLimit; // run ends here
+jmp_buf hostExit;
+unsigned hostFailures;
+unsigned hostResets;
+uint32_t hostWakes[HOST_WAKES]; // sleeps ended by each source
+
+// discharge time in ms of LED junction charged at ms, HOST_DARK when it does not discharge
+uint32_t (*hostLight)(uint64_t ms) = [](uint64_t) -> uint32_t { return 1; };
+
+// called at the end of each PWM period with LED on time in timer counts (0..256) per channel
+void (*hostPeriod)(const uint16_t on[3]);
+uint64_t hostOnCounts[3]; // LED on time in timer counts per channel
+uint32_t hostGlitches; // PWM periods with outputs switched after BOTTOM (runt pulse or spike)
+uint64_t hostAwakeClocks; // in idle sleep or busy waits, since hostChargeFrom
+uint64_t hostPllClocks; // with the PLL enabled, since hostChargeFrom
+uint64_t hostChargeFrom; // clock hostChargeUAs() counts from
+double hostChargeUs; // busy wait with the cathode driven high before the last sensing
+uint32_t hostShortCharges; // sensings started with the cathode high for less than HOST_CHARGE_US
+
+// called before and after time advances: sets PINB inputs at hostClock and sees the outputs firmware wrote
+void (*hostPins)();
+
+#if TRACE
+// called with the clock of the start bit edge of each byte received on the trace pin
+void (*hostTraced)(uint64_t clock, uint8_t byte);
+uint32_t hostTraceErrors; // frames without start or stop bit
+#endif
+
+// model state
+uint64_t hostWdtStart; // last watchdog reset
+uint16_t hostT0Prescale; // clocks since last Timer0 count
+uint8_t hostT0Last; // TCNT0 left by the model, a different value was written by firmware
+bool hostT0On;
+bool hostT0Stalled;
+bool hostT0Pending; // overflow interrupt flag set while interrupts were disabled
+bool hostInterrupts; // global interrupt flag
+bool hostSensing;
+uint64_t hostSenseStart;
+double hostCharging; // cathode driven high for, since the last sensing
+uint8_t hostOcr[3]; // compare values latched at BOTTOM
+uint8_t hostCom[3]; // compare output modes at BOTTOM
+#if TRACE
+bool hostTraceLevel = true; // trace pin level since the last capture, idles high
+uint64_t hostTraceStart; // start bit edge of the frame being received
+uint8_t hostTraceBit = 10; // next bit sampled, 10 when idle
+uint16_t hostTraceFrame; // bits sampled, LSB first
+#endif
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		hostFailures++; \
+	} \
+} while (0)
+
+inline double hostSeconds() {
+	return (double)hostClock / F_CPU;
+}
+
+inline uint64_t hostMs() {
+	return hostClock / HOST_CLOCKS_PER_MS;
+}
+
+inline uint64_t hostWdtTimeout() {
+	uint8_t wdto = (WDTCR & 7) | ((WDTCR >> WDP3 & 1) << 3);
+	return (uint64_t)(16U << wdto) * HOST_CLOCKS_PER_MS;
+}
+
+void halHostWatchdogReset() {
+	hostWdtStart = hostClock;
+}
+
+inline bool hostSensingPins() {
+	return (DDRB & _BV(Config::LED0_BIT)) == 0;
+}
+
+inline uint64_t hostDischargeAt() {
+	if (hostChargeUs < HOST_CHARGE_US)
+		return hostSenseStart;
+	uint32_t ms = hostLight(hostSenseStart / HOST_CLOCKS_PER_MS);
+	return ms == HOST_DARK ? UINT64_MAX : hostSenseStart + (uint64_t)ms * HOST_CLOCKS_PER_MS;
+}
+
+// sensing pins read as charged until discharge, and outside sensing as a freshly charged junction
+inline void hostUpdatePins() {
+	bool discharged = hostSensing && hostClock >= hostDischargeAt();
+	PINB = discharged ? PINB & ~_BV(Config::LED0_BIT) : PINB | _BV(Config::LED0_BIT);
+}
+
+inline bool hostTimer0On() {
+	return (PRR & _BV(PRTIM0)) == 0 && (TCCR0B & 7) != 0;
+}
+
+inline uint16_t hostTimer0Prescaler() {
+	static const uint16_t PRESCALERS[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+	if (!hostTimer0On() || hostT0Stalled || (MCUCR & _BV(SM1)) != 0)
+		return 0; // off, stalled or stopped in power-down
+	return PRESCALERS[TCCR0B & 7];
+}
+
+inline bool hostFastPwm() {
+	return (TCCR0A & (_BV(WGM01) | _BV(WGM00))) == (_BV(WGM01) | _BV(WGM00));
+}
+
+inline void hostComModes(uint8_t com[3]) {
+	com[0] = TCCR0A >> COM0A0 & 3;
+	com[1] = TCCR0A >> COM0B0 & 3;
+	com[2] = (TCCR1 & 0xf) != 0 && (GTCCR & _BV(PWM1B)) ? GTCCR >> COM1B0 & 3 : 0;
+}
+
+// on counts of a fast PWM period: non-inverting is on from BOTTOM to match, inverting after it
+inline uint16_t hostOnCount(uint8_t com, uint8_t ocr) {
+	return com == 2 ? ocr + 1 : com == 3 ? 255 - ocr : 0;
+}
+
+// latches compare values and output modes at BOTTOM
+void hostPwmLatch() {
+	hostComModes(hostCom);
+	hostOcr[0] = OCR0A;
+	hostOcr[1] = OCR0B;
+	hostOcr[2] = OCR1B;
+}
+
+// Timer0 BOTTOM in fast PWM: ends a period and latches compare values for the next one
+void hostPwmPeriod() {
+	uint8_t com[3];
+	hostComModes(com);
+	uint16_t on[3];
+	for (uint8_t c = 0; c < 3; c++) {
+		on[c] = hostOnCount(hostCom[c], hostOcr[c]);
+		hostOnCounts[c] += on[c];
+		if (com[c] != hostCom[c])
+			hostGlitches++;
+	}
+	if (hostPeriod)
+		hostPeriod(on);
+	hostPwmLatch();
+}
+
+// advances Timer0 by clocks, returns the number of overflows
+uint64_t hostAdvanceTimer0(uint64_t clocks) {
+	if (GTCCR & _BV(PSR0)) {
+		GTCCR &= ~_BV(PSR0); // prescaler reset clears itself
+		hostT0Prescale = 0;
+	}
+	if (hostTimer0On() && !hostT0On)
+		hostPwmLatch(); // started at BOTTOM
+	hostT0On = hostTimer0On();
+	uint16_t prescaler = hostTimer0Prescaler();
+	if (prescaler == 0)
+		return 0;
+	if (TCNT0 != hostT0Last)
+		hostT0Prescale = 0;
+	uint64_t total = (uint64_t)TCNT0 * prescaler + hostT0Prescale + clocks;
+	uint64_t overflows = total / (256U * prescaler);
+	total %= 256U * prescaler;
+	TCNT0 = hostT0Last = total / prescaler;
+	hostT0Prescale = total % prescaler;
+	if (hostFastPwm())
+		for (uint64_t i = 0; i < overflows; i++)
+			hostPwmPeriod();
+	return overflows;
+}
+
+// clocks to the next Timer0 interrupt, UINT64_MAX when none
+uint64_t hostTimer0Wait(bool& overflow) {
+	uint16_t prescaler = hostTimer0Prescaler();
+	if (prescaler == 0)
+		return UINT64_MAX;
+	uint16_t sub = TCNT0 != hostT0Last || GTCCR & _BV(PSR0) ? 0 : hostT0Prescale;
+	uint64_t wait = UINT64_MAX;
+	if (TIMSK & _BV(TOIE0)) {
+		wait = (uint64_t)(256 - TCNT0) * prescaler - sub;
+		overflow = true;
+	}
+	if (TIMSK & _BV(OCIE0A) && !hostFastPwm()) {
+		uint16_t counts = (uint8_t)(OCR0A - TCNT0);
+		uint64_t compare = (uint64_t)(counts == 0 ? 256 : counts) * prescaler - sub;
+		if (compare < wait) {
+			wait = compare;
+			overflow = false;
+		}
+	}
+	return wait;
+}
+
+#if TRACE
+// middle of bit of the frame being received
+inline uint64_t hostTraceSampleAt(uint8_t bit) {
+	return hostTraceStart + (2 * bit + 1) * (uint64_t)F_CPU / (2 * 9600);
+}
+
+// samples the trace pin level held since the last capture, then takes its level now; called before
+// time advances, so a level written by firmware holds from the current clock
+void hostTraceCapture() {
+	while (hostTraceBit < 10 && hostTraceSampleAt(hostTraceBit) < hostClock) {
+		hostTraceFrame |= hostTraceLevel << hostTraceBit;
+		if (++hostTraceBit < 10)
+			continue;
+		if ((hostTraceFrame & 0x201) != 0x200)
+			hostTraceErrors++;
+		else if (hostTraced)
+			hostTraced(hostTraceStart, hostTraceFrame >> 1);
+	}
+	bool level = (DDRB & _BV(PB3)) == 0 || (PORTB & _BV(PB3)) != 0; // an input is pulled up
+	if (hostTraceBit == 10 && hostTraceLevel && !level) {
+		hostTraceStart = hostClock;
+		hostTraceBit = 0;
+		hostTraceFrame = 0;
+	}
+	hostTraceLevel = level;
+}
+#endif
+
+#define HOST_RESET_REGISTER(name) name = 0;
+
+// firmware RAM that startup code clears or initializes, saved at host startup
+#define HOST_RAM(X) X(tcnt0h) X(tickEnd) X(nightLength) X(stats) X(statsSlot) X(statsSeq) X(params) X(dim) X(pattern) \
+	X(tasks) X(queue) X(queued) X(now) X(nowFraction) X(periodStart) X(periods) X(notified) X(show) X(light) X(night)
+#define HOST_RAM_FIELD(v) uint8_t v##Init[sizeof(v)];
+#define HOST_RAM_SAVE(v) memcpy(v##Init, (const void*)&v, sizeof(v));
+#define HOST_RAM_LOAD(v) memcpy((void*)&v, hostRam.v##Init, sizeof(v));
+
+struct HostRam {
+	HOST_RAM(HOST_RAM_FIELD)
+	HostRam() { HOST_RAM(HOST_RAM_SAVE) }
+} hostRam;
+
+// register values at power up or reset with the MCUSR flag
+void hostReset(uint8_t mcusr) {
+	HAL_HOST_REGS(HOST_RESET_REGISTER)
+	HOST_RAM(HOST_RAM_LOAD)
+	MCUSR = mcusr;
+	if (mcusr & _BV(WDRF))
+		WDTCR = _BV(WDE); // stays enabled after watchdog reset
+	PINB = _BV(PB3); // pulled up, no programmer attached
+	hostWdtStart = hostClock;
+	hostT0Prescale = 0;
+	hostT0Last = 0;
+	hostT0On = false;
+	hostT0Stalled = false;
+	hostT0Pending = false;
+	hostInterrupts = false;
+	hostSensing = false;
+	hostCharging = 0;
+	for (uint8_t c = 0; c < 3; c++)
+		hostOcr[c] = hostCom[c] = 0;
+	hostUpdatePins();
+}
+
+void halHostDelay(double us) {
+#if TRACE
+	hostTraceCapture();
+#endif
+	if ((DDRB & PORTB & _BV(Config::LED0_BIT)) != 0) {
+		hostSensing = false; // charging the cathode, a new sensing starts
+		hostCharging += us;
+		hostUpdatePins();
+	}
+	if (hostPins)
+		hostPins();
+	uint64_t clocks = us * HOST_CLOCKS_PER_MS / 1000;
+	uint64_t overflows = hostAdvanceTimer0(clocks);
+	hostClock += clocks;
+	if (PLLCSR & _BV(PLLE)) {
+		PLLCSR |= _BV(PLOCK);
+		hostPllClocks += clocks;
+	}
+	if (overflows != 0 && (TIMSK & _BV(TOIE0))) {
+		if (!hostInterrupts)
+			hostT0Pending = true;
+		else
+			for (uint64_t i = 0; i < overflows; i++)
+				TIM0_OVF_vect();
+	}
+	hostAwakeClocks += clocks;
+	if (hostPins)
+		hostPins();
+}
+
+void halHostSleep() {
+#if TRACE
+	hostTraceCapture();
+#endif
+	if (hostPins)
+		hostPins();
+	if (hostT0Pending && (TIMSK & _BV(TOIE0))) {
+		hostT0Pending = false;
+		hostWakes[HOST_PWM]++;
+		TIM0_OVF_vect();
+		return;
+	}
+	bool active = hostSensingPins();
+	if (active && !hostSensing) {
+		hostSenseStart = hostClock;
+		hostChargeUs = hostCharging;
+		hostCharging = 0;
+		if (hostChargeUs < HOST_CHARGE_US)
+			hostShortCharges++;
+	}
+	hostSensing = active;
+
+	uint64_t wake = UINT64_MAX;
+	HostWake source = HOST_WAKES;
+	if (WDTCR & (_BV(WDIE) | _BV(WDE))) {
+		uint64_t t = hostWdtStart + hostWdtTimeout();
+		wake = t > hostClock ? t : hostClock;
+		source = HOST_WDT;
+	}
+	bool overflow = false;
+	uint64_t timer = hostTimer0Wait(overflow);
+	if (timer != UINT64_MAX && hostClock + timer < wake) {
+		wake = hostClock + timer;
+		source = HOST_TIMER;
+	}
+	if (source == HOST_WAKES) {
+		printf("sleep without wake up source at %.3f s\n", hostSeconds());
+		hostFailures++;
+		longjmp(hostExit, HOST_STUCK);
+	}
+	bool idle = (MCUCR & _BV(SM1)) == 0;
+	if (wake > hostLimit) {
+		hostAdvanceTimer0(hostLimit - hostClock);
+		if (idle)
+			hostAwakeClocks += hostLimit - hostClock;
+		if (PLLCSR & _BV(PLLE))
+			hostPllClocks += hostLimit - hostClock;
+		hostClock = hostLimit;
+#if TRACE
+		hostTraceCapture();
+#endif
+		longjmp(hostExit, HOST_LIMIT);
+	}
+
+	hostAdvanceTimer0(wake - hostClock);
+	if (idle)
+		hostAwakeClocks += wake - hostClock;
+	if (PLLCSR & _BV(PLLE))
+		hostPllClocks += wake - hostClock;
+	hostClock = wake;
+	hostWakes[source == HOST_TIMER && hostFastPwm() ? HOST_PWM : source]++;
+	hostUpdatePins();
+	if (hostPins)
+		hostPins();
+	if (source == HOST_WDT) {
+		if ((WDTCR & _BV(WDIE)) == 0) {
+			hostResets++;
+			longjmp(hostExit, HOST_RESET);
+		}
+		if (WDTCR & _BV(WDE))
+			WDTCR &= ~_BV(WDIE); // interrupt and reset mode: next timeout resets
+		hostWdtStart = hostClock;
+		WDT_vect();
+	} else if (overflow)
+		TIM0_OVF_vect();
+	else
+		TIM0_COMPA_vect();
+}
+
+// charge drawn since hostChargeReset() in uAs by the firmware's current estimates
+double hostChargeUAs() {
+	uint64_t on = hostOnCounts[0] + hostOnCounts[1] + hostOnCounts[2]; // in clocks
+	uint64_t asleep = hostClock - hostChargeFrom - hostAwakeClocks;
+	return ((double)on * Config::LED_UA + (double)hostAwakeClocks * Config::IDLE_UA +
+		(double)hostPllClocks * Config::PLL_UA + (double)asleep * Config::SLEEP_UA) / F_CPU;
+}
+
+void hostChargeReset() {
+	hostChargeFrom = hostClock;
+	hostAwakeClocks = 0;
+	hostPllClocks = 0;
+	for (uint8_t c = 0; c < 3; c++)
+		hostOnCounts[c] = 0;
+}
+
+void halHostInterrupts(bool enabled) {
+	hostInterrupts = enabled;
+}
+
+// EEMEM variables are the EEPROM cells
+uint8_t eeprom_read_byte(const uint8_t* p) { return *p; }
+uint16_t eeprom_read_word(const uint16_t* p) { return *p; }
+void eeprom_update_byte(uint8_t* p, uint8_t value) { *p = value; }
+void eeprom_update_word(uint16_t* p, uint16_t value) { *p = value; }
+void eeprom_read_block(void* dst, const void* src, unsigned n) { memcpy(dst, src, n); }
+void eeprom_update_block(const void* src, void* dst, unsigned n) { memcpy(dst, src, n); }
+
+// runs firmware from power up for ms of simulated time, restarting it after watchdog resets
+void hostRun(uint64_t ms) {
+	hostLimit = hostClock + ms * HOST_CLOCKS_PER_MS;
+	hostReset(_BV(PORF));
+	switch (setjmp(hostExit)) {
+		case HOST_LIMIT:
+		case HOST_STUCK:
+			return;
+		case HOST_RESET:
+			hostReset(_BV(WDRF));
+			break;
+	}
+	firmwareMain();
+}
+
+// calls firmware code for up to ms of simulated time, returns false when it has not returned
+template<typename F> bool hostCall(F f, uint64_t ms) {
+	hostLimit = hostClock + ms * HOST_CLOCKS_PER_MS;
+	if (setjmp(hostExit))
+		return false;
+	f();
+	return true;
+}
+
+// day and night script for hostLight: light from dawn to dusk, the run starts at start o'clock
+struct HostDay {
+	uint8_t start = 12;
+	uint8_t dawn = 6;
+	uint8_t dusk = 18;
+	int8_t flashDay = -1; // day of the run (0 until the first midnight) with two flashlight flashes, -1 none
+	uint8_t flashHour = 22;
+} hostDay;
+uint64_t hostFlashSeen; // first flash is on from flashHour until 1s after it is seen
+
+uint32_t hostDaylight(uint64_t ms) {
+	uint64_t t = ms + hostDay.start * HOST_HOUR_MS;
+	uint64_t day = t % (24 * HOST_HOUR_MS);
+	if (hostDay.flashDay >= 0 && t / (24 * HOST_HOUR_MS) == (uint64_t)hostDay.flashDay &&
+			day >= hostDay.flashHour * HOST_HOUR_MS && day < hostDay.flashHour * HOST_HOUR_MS + 60000) {
+		if (hostFlashSeen == 0)
+			hostFlashSeen = ms;
+		uint64_t flash = ms - hostFlashSeen;
+		return flash < 1000 || (flash >= 2500 && flash < 4000) ? 1 : HOST_DARK;
+	}
+	return day >= hostDay.dawn * HOST_HOUR_MS && day < hostDay.dusk * HOST_HOUR_MS ? 1 : HOST_DARK;
+}
+
+// plays show with the effect and sense tasks, as schedule() does without the main task
+void hostPlayShow(ShowStart start) {
+	startShow(start, 0);
+	for (;;) {
+		do {
+			notified = false;
+			effectTask();
+			senseTask();
+		} while (notified);
+		if (!show.playing)
+			return;
+		sleepUntilNext();
+	}
+}
+
+// registers as main() sets them up before the first show, for tests calling firmware functions
+void hostSetup() {
+	hostReset(_BV(PORF));
+	seedRandom();
+	charge = MAX_CHARGE;
+	PRR = Timer1::PRR_MASK | Timer0::PRR_MASK | Power::UNUSED;
+	DDRB = LED_BITS;
+	PORTB = 0xff & ~LED_BITS;
+	Sleep::powerDown();
+	Sleep::enable();
+}
+
+#endif // HOST_H_
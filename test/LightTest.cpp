@@ -0,0 +1,58 @@
+// Light sensing task: darkness levels and timing, pins are restored after sensing
+
+#include "Host.h"
+
+uint32_t dischargeMs;
+const uint8_t LEVELS = 5;
+
+// senses light with the sense task alone, returns the darkness level
+uint8_t sense(uint8_t wdto, uint8_t levels) {
+	light.wdto = wdto;
+	light.levels = levels;
+	light.sensing = true;
+	CHECK(hostCall([]() {
+		for (;;) {
+			senseTask();
+			if (!light.sensing)
+				return;
+			sleepUntilNext();
+		}
+	}, 1000));
+	CHECK(hostShortCharges == 0); // the busy wait fully charges the junction
+	CHECK(hostChargeUs >= Config::CHARGE_US && hostChargeUs >= HOST_CHARGE_US);
+	CHECK(DDRB == LED_BITS);
+	CHECK((PORTB & LED_BITS) == 0);
+	return light.level;
+}
+
+void senses(uint32_t ms, uint8_t level, uint16_t waited) {
+	dischargeMs = ms;
+	hostLight = [](uint64_t) { return dischargeMs; };
+	uint64_t start = hostMs();
+	uint32_t wakes = hostWakes[HOST_WDT];
+	CHECK(sense(WDTO_15MS, LEVELS) == level);
+	// discharge is seen at the end of a watchdog wait, one wake up each
+	CHECK(hostMs() - start == waited);
+	CHECK(hostWakes[HOST_WDT] - wakes == level + (level < LEVELS) + 0U);
+	CHECK(now == (uint16_t)hostMs());
+}
+
+int main() {
+	hostSetup();
+
+	// night is a whole NIGHT_WDTO without discharge
+	hostLight = [](uint64_t) { return 1U; };
+	CHECK(sense(Config::NIGHT_WDTO, 1) == 0);
+	hostLight = [](uint64_t) { return HOST_DARK; };
+	CHECK(sense(Config::NIGHT_WDTO, 1) == 1);
+
+	// doubling waits of 16, 32, 64, 128, 256ms end at 16, 48, 112, 240, 496ms
+	senses(5, 0, 16);
+	senses(40, 1, 48);
+	senses(100, 2, 112);
+	senses(200, 3, 240);
+	senses(400, 4, 496);
+	senses(HOST_DARK, 5, 496);
+
+	return hostFailures != 0;
+}
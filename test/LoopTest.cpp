@@ -0,0 +1,21 @@
+// Main loop over days: a show at dawn, night length learning, pre-dawn show and flashlight gesture
+
+#include "Host.h"
+
+int main() {
+	hostDay.flashDay = 1; // starts at noon, flashes on the second night at 22:00
+	hostLight = hostDaylight;
+	hostRun(4 * 24 * HOST_HOUR_MS);
+	CHECK(hostResets == 0);
+	CHECK(stats.nights == 4);
+	// night length is learned from the first night, within the polling delays of dusk and dawn
+	const uint16_t NIGHT_PERIODS = 12 * HOST_HOUR_MS / PERIOD_MS;
+	CHECK(nightLength + 1 >= NIGHT_PERIODS && nightLength <= NIGHT_PERIODS + 2);
+	CHECK(eeprom_read_word(&eeprom.nightLength) == nightLength);
+	// at boot, at every dawn, pre-dawn from the second night and one on the flashlight gesture
+	CHECK(stats.shows == 1 + 4 + 3 + 1);
+	CHECK(stats.fullShows == stats.shows);
+	CHECK(stats.lightFlips == 0);
+	printf("wakes: %u watchdog, %u timer, %u PWM\n", hostWakes[HOST_WDT], hostWakes[HOST_TIMER], hostWakes[HOST_PWM]);
+	return hostFailures != 0;
+}
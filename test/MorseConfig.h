@@ -0,0 +1,4 @@
+// Test configuration: a message of two words
+struct MorseConfig : DefaultConfig {
+	static constexpr const char* MESSAGE = "E E";
+};
@@ -0,0 +1,51 @@
+// Morse message show: 7 unit word gaps, also before repeating, and whole messages for the show time
+
+#include "Host.h"
+
+const uint16_t UNIT = Config::MORSE_UNIT_MS;
+
+uint64_t litStart, litEnd; // of the last symbol in clocks
+uint32_t symbols;
+uint32_t gapErrors;
+bool lit;
+
+// symbols and dark gaps between them from LED on time of PWM periods
+void period(const uint16_t on[3]) {
+	bool now = on[0] + on[1] + on[2] != 0;
+	if (now == lit)
+		return;
+	lit = now;
+	if (lit) {
+		litStart = hostClock;
+		uint64_t gap = (litStart - litEnd) / HOST_CLOCKS_PER_MS;
+		// E is a dot: the fades at its ends are a few dark periods of the 7 unit gap
+		if (symbols != 0 && (gap < 7 * UNIT * 99 / 100 || gap > 7 * UNIT * 101 / 100 + 2 * Config::MORSE_FADE_MS)) {
+			printf("gap of %u ms after symbol %u\n", (unsigned)gap, symbols);
+			gapErrors++;
+		}
+	} else {
+		litEnd = hostClock;
+		symbols++;
+		CHECK((litEnd - litStart) / HOST_CLOCKS_PER_MS <= UNIT * 1024000UL / F_CPU); // in ticks of 1024 clocks
+	}
+}
+
+int main() {
+	hostSetup();
+	hostPeriod = period;
+	params.effect = EFFECT_MESSAGE;
+	static_assert(messageUnits() == 2 * (2 + 2 + 4), "E E is two dots, two letter gaps and two word gaps");
+
+	uint64_t start = hostMs();
+	CHECK(hostCall([]() { hostPlayShow(SHOW_BOOT); }, 1000000));
+	CHECK(!show.stopped);
+	CHECK(gapErrors == 0);
+	// the message repeats as a whole for the time of a show of lit cycles, not one letter per cycle
+	uint32_t repeats = Config::SHOW_CYCLES * CYCLE_MS / (16 * UNIT);
+	CHECK(show.cycles == repeats * MESSAGE_LENGTH);
+	CHECK(symbols == 2 * repeats);
+	uint64_t ms = hostMs() - start;
+	CHECK(ms > (uint64_t)Config::SHOW_CYCLES * CYCLE_MS * 9 / 10 && ms < (uint64_t)Config::SHOW_CYCLES * CYCLE_MS * 11 / 10);
+	printf("%u symbols in %.1f s\n", symbols, ms / 1000.0);
+	return hostFailures != 0;
+}
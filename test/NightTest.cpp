@@ -0,0 +1,14 @@
+// Night length learning skips the first night after power up when it had begun before
+
+#include "Host.h"
+
+int main() {
+	hostDay.start = 22; // night from 18:00 to 6:00
+	hostLight = hostDaylight;
+	// until 7:00 the next day, the partial night would be learned as 8 hours
+	hostRun(9 * HOST_HOUR_MS);
+	CHECK(stats.nights == 1);
+	CHECK(nightLength == 0);
+	CHECK(eeprom_read_word(&eeprom.nightLength) == 0); // not written
+	return hostFailures != 0;
+}
@@ -0,0 +1,4 @@
+// Test configuration: pale colors, every hue lights all three channels
+struct PaleConfig : DefaultConfig {
+	static constexpr uint8_t SATURATION = 0x80;
+};
@@ -0,0 +1,96 @@
+// Hue palette: distinct hues with pure primaries, EFFECT_HUES chooses all of the wheel and
+// EFFECT_EFFICIENT never lights LED1 (blue), so it gives more perceived light per charge.
+// Also run with the white balance of test/BalancedConfig.h.
+
+#include "Host.h"
+#include "../tools/ToolParams.h"
+
+const uint16_t DRAWS = 64 * HUES;
+
+// relative luminous intensity at the same current of LED1 (blue ~470nm), LED2 (green ~525nm) and
+// LED3 (red ~625nm) in a common RGB LED, rough datasheet figures weighted by eye sensitivity
+const double LUMINOUS[3] = { 0.3, 1, 0.45 };
+const double PERIOD_S = 256.0 / F_CPU; // PWM period
+
+// hue of palette entry as read by the firmware
+void hueOf(uint8_t h, uint8_t v[3]) {
+	for (uint8_t c = 0; c < 3; c++)
+		v[c] = pgm_read_byte(&hues[h][c]);
+}
+
+// counts how often chooseHue() returns each hue for the effect, kinds 1..3 in turn
+void choose(Effect effect, uint16_t chosen[HUES]) {
+	params.effect = effect;
+	seedRandom();
+	for (uint8_t h = 0; h < HUES; h++)
+		chosen[h] = 0;
+	for (uint16_t i = 0; i < DRAWS; i++) {
+		uint8_t h = chooseHue(i % 3 + 1);
+		CHECK(h < HUES);
+		if (h < HUES)
+			chosen[h]++;
+	}
+}
+
+// perceived brightness per uAh of a dawn show of the effect: PWM on time weighted by LUMINOUS
+// (in seconds of LED2 at full duty) over the modeled charge of LED and idle current
+double efficiency(Effect effect) {
+	for (uint8_t c = 0; c < 3; c++)
+		hostOnCounts[c] = 0;
+	uint32_t wakes = hostWakes[HOST_PWM];
+	params.effect = effect;
+	hostLight = [](uint64_t) { return 50U; };
+	CHECK(hostCall([]() { hostPlayShow(SHOW_DAWN); }, 200000));
+	CHECK(!show.stopped);
+	double light = 0, uAs = (hostWakes[HOST_PWM] - wakes) * PERIOD_S * Config::IDLE_UA;
+	for (uint8_t c = 0; c < 3; c++) {
+		double fullS = hostOnCounts[c] / 256.0 * PERIOD_S;
+		light += fullS * LUMINOUS[c];
+		uAs += fullS * Config::LED_UA;
+	}
+	double perUAh = light / (uAs / 3600);
+	printf("%-10s %.4f s per uAh, %.1f uAh\n", TOOL_EFFECT_NAMES[effect], perUAh, uAs / 3600);
+	return perUAh;
+}
+
+int main() {
+	hostSetup();
+	static_assert(Config::SATURATION == 0xff, "primaries are pure at full saturation");
+
+	uint8_t a[3], b[3];
+	for (uint8_t h = 0; h < HUES; h++) {
+		hueOf(h, a);
+		for (uint8_t k = h + 1; k < HUES; k++) {
+			hueOf(k, b);
+			CHECK(memcmp(a, b, 3) != 0);
+		}
+	}
+	// hue 0 is LED1, HUES / 3 is LED2 and 2 * HUES / 3 is LED3 at their white balanced full level
+	const uint8_t SCALES[3] = { Config::LED1_SCALE, Config::LED2_SCALE, Config::LED3_SCALE };
+	for (uint8_t p = 0; p < 3; p++) {
+		hueOf(p * HUES / 3, a);
+		for (uint8_t c = 0; c < 3; c++)
+			CHECK(a[c] == (c == p ? SCALES[c] : 0));
+	}
+
+	uint16_t chosen[HUES];
+	choose(EFFECT_HUES, chosen);
+	for (uint8_t h = 0; h < HUES; h++)
+		CHECK(chosen[h] > DRAWS / HUES / 2 && chosen[h] < DRAWS / HUES * 2);
+	choose(EFFECT_EFFICIENT, chosen);
+	for (uint8_t h = 0; h < HUES; h++) {
+		hueOf(h, a);
+		CHECK(chosen[h] == 0 || a[0] == 0);
+		CHECK((chosen[h] != 0) == (h >= HUES / 3 && h < 2 * HUES / 3)); // green, yellow to orange
+	}
+	choose(EFFECT_ONE_COLOR, chosen);
+	for (uint8_t h = 0; h < HUES; h++)
+		CHECK((chosen[h] != 0) == (h % (HUES / 3) == 0));
+
+	// whole shows: the efficient effect never lights LED1 and beats all hues in light per charge
+	double hues = efficiency(EFFECT_HUES);
+	double efficient = efficiency(EFFECT_EFFICIENT);
+	CHECK(hostOnCounts[0] == 0 && hostOnCounts[1] > 0 && hostOnCounts[2] > 0);
+	CHECK(efficient > hues * 1.1);
+	return hostFailures != 0;
+}
@@ -0,0 +1,4 @@
+// Test configuration: Timer1 clocked from the PLL
+struct PllConfig : DefaultConfig {
+	static constexpr bool TIMER1_PLL = true;
+};
@@ -0,0 +1,77 @@
+// PWM output: each period is on for exactly the dithered compare value, zero is off without spikes,
+// and ticks keep their length when a scheduler pass overruns PWM periods. Also run with Timer1 clocked
+// from the PLL (test/PllConfig.h), which is on during lit cycles only.
+
+#include "Host.h"
+
+const uint16_t PERIODS = 4 * 8;
+uint16_t on[PERIODS][3];
+uint16_t pwmPeriods;
+const uint8_t PLL_ON = _BV(LSM) | _BV(PLLE) | _BV(PLOCK) | _BV(PCKE);
+uint16_t pllPeriods; // with Timer1 clocked from the locked PLL
+const uint8_t TICKS = 16;
+double passUs, longPassUs;
+
+// ticks with a scheduler pass of passUs after each, longPassUs after the 4th, checks their timing
+// and the statistics of late ones
+void passes(double us, double longUs, uint16_t lateTicks) {
+	passUs = us;
+	longPassUs = longUs;
+	stats.tickClocks = stats.lateTicks = 0;
+	uint64_t start = hostClock;
+	CHECK(hostCall([]() {
+		startCycle();
+		for (uint8_t i = 0; i < TICKS; i++) {
+			outputTick(0x8000, 0x4000, 0);
+			_delay_us(i == 3 ? longPassUs : passUs);
+		}
+		stopCycle();
+	}, 1000));
+	// ticks end at every 4th overflow from the start of the cycle, passes delay compare values only
+	CHECK(hostClock - start == TICKS * 1024 + (uint64_t)us + (Config::TIMER1_PLL ? 100 : 0));
+	CHECK(stats.tickClocks == (uint16_t)(longUs > us ? longUs : us));
+	CHECK(stats.lateTicks == lateTicks);
+	CHECK(hostGlitches == 0);
+}
+
+int main() {
+	hostSetup();
+	hostPeriod = [](const uint16_t o[3]) {
+		if (pwmPeriods < PERIODS)
+			for (uint8_t c = 0; c < 3; c++)
+				on[pwmPeriods][c] = o[c];
+		pwmPeriods++;
+		if (PLLCSR == PLL_ON)
+			pllPeriods++;
+	};
+	// channel 1 rises from 0, channel 2 falls to 0 and channel 3 stays off, with dithered fractions
+	static const uint16_t levels[8][3] = {
+		{ 0, 0x4000, 0 }, { 0x0040, 0x2000, 0 }, { 0x0100, 0x0180, 0 }, { 0x0180, 0x0100, 0 },
+		{ 0x2000, 0x0040, 0 }, { 0x4000, 0, 0 }, { 0xff00, 0, 0 }, { 0, 0, 0 }
+	};
+	CHECK(hostCall([]() {
+		startCycle();
+		for (uint8_t i = 0; i < 8; i++)
+			outputTick(levels[i][0], levels[i][1], levels[i][2]);
+		stopCycle();
+	}, 1000));
+	CHECK(pwmPeriods == PERIODS);
+	CHECK(pllPeriods == (Config::TIMER1_PLL ? PERIODS : 0));
+	CHECK(PLLCSR == 0);
+	CHECK(hostGlitches == 0);
+	CHECK((WDTCR & (_BV(WDE) | _BV(WDIE))) == 0); // hang guard is disarmed
+	// period k + 1 plays compare values written before overflow k
+	for (uint8_t k = 0; k + 1 < PERIODS; k++) {
+		uint8_t d = (k & 1 ? 0x80 : 0) | (k & 2 ? 0x40 : 0);
+		for (uint8_t c = 0; c < 3; c++) {
+			uint8_t level = (levels[k / 4][c] + d) >> 8;
+			CHECK(on[k + 1][c] == level);
+		}
+	}
+
+	passes(200, 200, 0);
+	passes(300, 300, TICKS - 1); // all but the first tick miss their 0x00 dither period
+	passes(700, 700, TICKS - 1); // more than two periods, an overflow lost to a snapshot of the count
+	passes(100, 3000, 3); // a long pass, two ticks are wholly late and the third partly
+	return hostFailures != 0;
+}
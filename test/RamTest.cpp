@@ -0,0 +1,26 @@
+// RAM budget: firmware state with a stack reserve fits the 256 bytes of an ATtiny45 and not the 64 bytes
+// of an ATtiny13A. Host sizes include alignment padding the AVR build does not have, so they bound it.
+
+#include "Host.h"
+
+const unsigned ATTINY45_RAM = 256;
+const unsigned ATTINY13A_RAM = 64;
+// main() -> schedule() -> task -> startShow() or startHue() -> random(), each call with a return
+// address and the call-saved registers it uses, and an interrupt frame on top
+const unsigned STACK_RESERVE = 64;
+
+#define RAM_SIZE(v) + sizeof(v)
+const unsigned STATE = 0 HOST_RAM(RAM_SIZE); // .data and .bss
+const unsigned NOINIT_STATE = sizeof(resume) + sizeof(x) + sizeof(a) + sizeof(b) + sizeof(c) + sizeof(charge);
+
+static_assert(STATE + NOINIT_STATE + STACK_RESERVE <= ATTINY45_RAM, "firmware state does not fit an ATtiny45");
+static_assert(STATE + NOINIT_STATE > ATTINY13A_RAM, "firmware state would fit an ATtiny13A");
+
+int main() {
+	printf("RAM: %u bytes of state, %u noinit, %u stack reserve of %u bytes on ATtiny45\n", STATE, NOINIT_STATE,
+		STACK_RESERVE, ATTINY45_RAM);
+	printf("  stats %u, tasks %u, show %u, pattern %u, light %u, night %u\n", (unsigned)sizeof(stats),
+		(unsigned)sizeof(tasks), (unsigned)sizeof(show), (unsigned)sizeof(pattern), (unsigned)sizeof(light),
+		(unsigned)sizeof(night));
+	return hostFailures != 0;
+}
@@ -0,0 +1,52 @@
+// Shows: timers are left off after a show, the night state stop condition and energy budget trim it
+
+#include "Host.h"
+
+void checkStopped() {
+	CHECK((PRR & (Timer0::PRR_MASK | Timer1::PRR_MASK)) == (Timer0::PRR_MASK | Timer1::PRR_MASK));
+	CHECK((TIMSK & (_BV(TOIE0) | _BV(OCIE0A))) == 0);
+	CHECK(TCCR0B == 0 && TCCR1 == 0);
+	CHECK((TCCR0A & (_BV(COM0A1) | _BV(COM0B1))) == 0 && (GTCCR & _BV(COM1B1)) == 0);
+	CHECK(MCUCR & _BV(SM1)); // power-down
+	CHECK(DDRB == LED_BITS && (PORTB & LED_BITS) == 0);
+	CHECK(resume.magic == 0);
+	CHECK(hostGlitches == 0);
+}
+
+int main() {
+	hostSetup();
+
+	// dusk show plays all cycles in about 2 minutes
+	hostLight = [](uint64_t) { return 50U; };
+	uint64_t start = hostMs();
+	CHECK(hostCall([]() { hostPlayShow(SHOW_DAWN); }, 200000));
+	CHECK(!show.stopped);
+	CHECK(show.cycle == Config::SHOW_CYCLES);
+	CHECK(dim == 1); // discharged in the third wait of dusk levels 0..3
+	CHECK(stats.shows == 1 && stats.fullShows == 1);
+	uint64_t ms = hostMs() - start;
+	CHECK(ms > 100000 && ms < 140000);
+	CHECK(hostOnCounts[0] + hostOnCounts[1] + hostOnCounts[2] > 0);
+	checkStopped();
+
+	// night show stops within a few cycles after light comes back
+	static uint64_t dawn;
+	dawn = hostMs() + 10000;
+	hostLight = [](uint64_t ms) { return ms < dawn ? HOST_DARK : 1U; };
+	CHECK(hostCall([]() { hostPlayShow(SHOW_PRE_DAWN); }, 200000));
+	CHECK(show.stopped);
+	CHECK(dim == 2); // dimmest in darkness
+	CHECK(hostMs() > dawn && hostMs() < dawn + 5000);
+	CHECK(stats.shows == 2 && stats.fullShows == 1);
+	checkStopped();
+
+	// show is trimmed when energy budget is spent
+	hostLight = [](uint64_t) { return HOST_DARK; };
+	charge = 0;
+	CHECK(hostCall([]() { hostPlayShow(SHOW_PRE_DAWN); }, 200000));
+	CHECK(show.stopped);
+	CHECK(stats.budgetStops == 1);
+	checkStopped();
+
+	return hostFailures != 0;
+}
@@ -0,0 +1,73 @@
+// Statistics read back by tools/StatsExtractor from an Intel HEX dump of the EEPROM after 10 days, with
+// the slots wrapped around and a watchdog reset
+
+#include "Host.h"
+#include "../tools/StatsExtractor.h"
+
+static_assert(DUMP_SIZE == E2END + 1 && DUMP_LAYOUT == EEPROM_LAYOUT && DUMP_PARAMS == offsetof(Eeprom, params) &&
+	DUMP_PARAMS_CHECK == offsetof(Eeprom, paramsCheck) && DUMP_LAYOUT_OFFSET == offsetof(Eeprom, layout) &&
+	DUMP_SLOTS_OFFSET == offsetof(Eeprom, statsSlots) && DUMP_STATS == offsetof(Eeprom, stats) &&
+	DUMP_STATS_SIZE == sizeof(Stats), "extractor layout");
+static_assert(TOOL_PARAMS_SIZE == sizeof(Params) && TOOL_EFFECTS == EFFECTS, "tool parameters");
+
+const uint16_t DAYS = 10;
+
+// Timer0 stalls in a cycle of the third pre-dawn show
+void hang(const uint16_t*) {
+	if (hostResets == 0 && resume.start == SHOW_PRE_DAWN && resume.cycle == 10 && stats.nights == 3)
+		hostT0Stalled = true;
+}
+
+char text[8 * 1024];
+uint8_t image[DUMP_SIZE];
+
+// EEPROM as a dump, read back by the extractor
+bool extract(Dump& d) {
+	memset(image, 0xff, sizeof(image));
+	memcpy(image, &eeprom, sizeof(eeprom));
+	FILE* f = tmpfile();
+	printIntelHex(f, image, sizeof(image));
+	rewind(f);
+	size_t length = fread(text, 1, sizeof(text) - 1, f);
+	text[length] = 0;
+	fclose(f);
+	memset(image, 0xff, sizeof(image));
+	int line;
+	CHECK(parseIntelHex(text, image, sizeof(image), line));
+	return readDump(image, d);
+}
+
+int main() {
+	Dump d;
+	CHECK(!extract(d)); // zeroed
+	memset(&eeprom, 0xff, sizeof(eeprom));
+	CHECK(!extract(d)); // erased, as the run starts
+
+	hostLight = hostDaylight; // starts at noon, night from 18:00 to 6:00
+	hostPeriod = hang;
+	hostRun(DAYS * 24 * HOST_HOUR_MS);
+	CHECK(hostResets == 1);
+	loadStats(); // as of the last dawn
+	CHECK(stats.nights == DAYS);
+	CHECK(stats.resets == 1);
+	CHECK(extract(d));
+	CHECK(d.slots == Config::STATS_SLOTS);
+	CHECK(d.slot == statsSlot && d.seq == statsSeq);
+	CHECK(d.slot == DAYS % Config::STATS_SLOTS); // erased slot 0 is the latest at first
+	CHECK(memcmp(&d.stats, &stats, sizeof(Stats)) == 0);
+	CHECK(d.stats.nights == stats.nights && d.stats.shows == stats.shows && d.stats.cycles == stats.cycles &&
+		d.stats.usedUAs == stats.usedUAs && d.stats.resets == stats.resets);
+	CHECK(d.stats.fullShows + d.stats.budgetStops <= d.stats.shows); // light stops do not wrap
+	CHECK(d.nightLength == nightLength && nightLength != 0);
+	CHECK(!d.paramsSet);
+	printDump(stdout, d);
+
+	eeprom.params = Params { 100, 2, EFFECT_PATTERN };
+	eeprom.paramsCheck = paramsCheck(eeprom.params);
+	CHECK(extract(d));
+	CHECK(d.paramsSet && d.params[0] == 100 && d.params[1] == 2 && d.params[2] == EFFECT_PATTERN);
+	text[3] ^= 1; // checksum of the first record
+	int line;
+	CHECK(!parseIntelHex(text, image, sizeof(image), line) && line == 1);
+	return hostFailures != 0;
+}
@@ -0,0 +1,46 @@
+// Trace received from the PB3 pin and decoded by tools/TraceDecoder: events match the firmware's counts,
+// and watchdog sleeps last their timeout
+
+#include "Host.h"
+#include "../tools/TraceDecoder.h"
+
+static_assert(TRACE, "compiled with -DTRACE=1");
+static_assert(TRACE_SLEEP >> 5 == TRACE_CODE_SLEEP && TRACE_WAKE >> 5 == TRACE_CODE_WAKE &&
+	TRACE_ISR >> 5 == TRACE_CODE_ISR && TRACE_CYCLE >> 5 == TRACE_CODE_CYCLE &&
+	TRACE_LIGHT >> 5 == TRACE_CODE_LIGHT && TRACE_SHOW >> 5 == TRACE_CODE_SHOW, "decoder event codes");
+
+TraceTimeline timeline;
+
+void traced(uint64_t clock, uint8_t e) {
+	timeline.add(clock * 1000 / HOST_CLOCKS_PER_MS, e);
+}
+
+int main() {
+	hostLight = hostDaylight; // starts at noon, night from 18:00 to 6:00
+	hostTraced = traced;
+	hostRun(24 * HOST_HOUR_MS);
+	CHECK(hostTraceErrors == 0);
+	CHECK(timeline.disorders == 0);
+	CHECK(timeline.count[TRACE_CODE_SHOW][SHOW_BOOT] == 1);
+	CHECK(timeline.count[TRACE_CODE_SHOW][SHOW_DAWN] == 1);
+	CHECK(timeline.total(TRACE_CODE_SHOW) == stats.shows);
+	CHECK(timeline.total(TRACE_CODE_CYCLE) - timeline.count[TRACE_CODE_CYCLE][0] == stats.cycles);
+	CHECK(timeline.count[TRACE_CODE_ISR][TRACE_WDT] == hostWakes[HOST_WDT]);
+	CHECK(timeline.count[TRACE_CODE_ISR][TRACE_TIMER] == hostWakes[HOST_TIMER]);
+	// the run ends asleep, in a state not timed
+	CHECK(timeline.state >> 5 == TRACE_CODE_SLEEP);
+	CHECK(timeline.total(TRACE_CODE_SLEEP) == timeline.total(TRACE_CODE_WAKE) + 1);
+	CHECK(timeline.total(TRACE_CODE_LIGHT) > 0);
+	// a sleep state lasts from the entry frame to the interrupt frame: the timeout after one 1ms frame
+	for (uint8_t wdto = 0; wdto <= WDTO_8S; wdto++) {
+		uint32_t n = timeline.count[TRACE_CODE_SLEEP][wdto] - (timeline.state == (TRACE_SLEEP | wdto));
+		uint64_t timeout = (16U << wdto) * 1000ULL;
+		CHECK(n == 0 || (timeline.us[TRACE_CODE_SLEEP][wdto] >= n * (timeout + 1000) &&
+			timeline.us[TRACE_CODE_SLEEP][wdto] <= n * (timeout + 1100)));
+	}
+	// the timeline covers the run from the first event, and it is mostly asleep
+	CHECK(timeline.last - timeline.first <= 24 * HOST_HOUR_MS * 1000 && timeline.last - timeline.first > 23 * HOST_HOUR_MS * 1000);
+	CHECK(timeline.time(TRACE_CODE_SLEEP) > (timeline.last - timeline.first) * 9 / 10);
+	printTraceSummary(stdout, timeline);
+	return hostFailures != 0;
+}
@@ -0,0 +1,64 @@
+// Configuration wire end to end: tools/WireSender's message driven on PB3 at power up is saved,
+// acknowledged with a LED1 blink and used from then on; a corrupted one is ignored
+
+#include "Host.h"
+#include "../tools/WireSender.h"
+
+static_assert(Config::CONFIG_WIRE, "compiled with the configuration wire");
+static_assert(WIRE_MESSAGE_SIZE == 2 + sizeof(Params) && TOOL_EFFECTS == EFFECTS, "sender message");
+
+const uint64_t RELEASE_US = 3000000; // programmer releases PB3 3s after power up
+const uint64_t START_US = RELEASE_US + 10000;
+
+uint8_t bytes[WIRE_MESSAGE_SIZE];
+WireWaveform wire = { bytes, sizeof(bytes), RELEASE_US, START_US };
+bool attached;
+uint64_t powerUp;
+uint64_t blinkOn, blinkOff; // first LED1 blink in us from power up
+
+void pins() {
+	uint64_t us = (hostClock - powerUp) * 1000 / HOST_CLOCKS_PER_MS;
+	bool level = !attached || wire.level(us);
+	PINB = level ? PINB | _BV(PB3) : PINB & ~_BV(PB3);
+	bool lit = (DDRB & PORTB & _BV(Config::LED1_BIT)) != 0;
+	if (lit && blinkOn == 0)
+		blinkOn = us;
+	if (!lit && blinkOn != 0 && blinkOff == 0)
+		blinkOff = us;
+}
+
+// powers up with the programmer attached or not, runs until the boot show has started
+void boot(bool programmer) {
+	attached = programmer;
+	blinkOn = blinkOff = 0;
+	powerUp = hostClock;
+	hostRun(10000);
+	CHECK(show.playing);
+}
+
+int main() {
+	hostPins = pins;
+	const Params sent = { 40, 1, EFFECT_ONE_COLOR };
+	wireMessage(sent.showCycles, sent.dim, sent.effect, bytes);
+	CHECK(bytes[4] == paramsCheck(sent));
+	boot(true);
+	CHECK(memcmp(&eeprom.params, &sent, sizeof(Params)) == 0);
+	CHECK(eeprom.paramsCheck == paramsCheck(sent));
+	CHECK(memcmp(&params, &sent, sizeof(Params)) == 0);
+	CHECK(show.cycles == sent.showCycles);
+	// the blink starts once the last stop bit is in, and lasts 256ms
+	CHECK(blinkOn + 2000 >= wire.end() && blinkOn <= wire.end() + 1000);
+	CHECK(blinkOff - blinkOn >= 256000 && blinkOff - blinkOn <= 257000);
+
+	boot(false); // parameters kept, no blink
+	CHECK(memcmp(&params, &sent, sizeof(Params)) == 0);
+	CHECK(blinkOn == 0);
+
+	wireMessage(100, 0, EFFECT_HUES, bytes);
+	bytes[4]++; // check byte
+	boot(true);
+	CHECK(memcmp(&eeprom.params, &sent, sizeof(Params)) == 0);
+	CHECK(memcmp(&params, &sent, sizeof(Params)) == 0);
+	CHECK(blinkOn == 0);
+	return hostFailures != 0;
+}
@@ -0,0 +1,41 @@
+// Converts a CSV of light pattern keyframes (file argument or stdin) into a Pattern.h initializer on stdout
+
+#include "PatternEncoder.h"
+
+const int MAX_KEYS = 1024;
+const int MAX_RECORDS = 4096;
+
+char text[64 * MAX_KEYS];
+PatternKey keys[MAX_KEYS];
+PatternRecord records[MAX_RECORDS];
+uint8_t bytes[MAX_RECORDS * PATTERN_RAMP_SIZE + 1];
+
+int main(int argc, char** argv) {
+	FILE* in = argc > 1 ? fopen(argv[1], "r") : stdin;
+	if (in == nullptr) {
+		fprintf(stderr, "cannot open %s\n", argv[1]);
+		return 1;
+	}
+	size_t length = fread(text, 1, sizeof(text) - 1, in);
+	text[length] = 0;
+	int line;
+	int count = parsePatternCsv(text, keys, MAX_KEYS, line);
+	if (count < 0) {
+		fprintf(stderr, "line %d: expected ticks,level1,level2,level3 with ticks 1..65535 and levels 0..255\n", line);
+		return 1;
+	}
+	int n = encodePattern(keys, count, records, MAX_RECORDS);
+	if (n < 0) {
+		fprintf(stderr, "pattern must end dark, change levels by at most 127 in one tick and fit %d records\n",
+			MAX_RECORDS);
+		return 1;
+	}
+	uint32_t ticks = 0;
+	for (int i = 0; i < count; i++)
+		ticks += keys[i].ticks;
+	uint16_t size = patternBytes(records, n, bytes);
+	printf("\t// %d keyframes, %u ticks: %u bytes (raw frames %u bytes, %.1f:1)\n", count, (unsigned)ticks, size,
+		(unsigned)(3 * ticks), 3.0 * ticks / size);
+	printPattern(stdout, records, n);
+	return 0;
+}
@@ -0,0 +1,134 @@
+/*
+  Light pattern encoder: converts keyframes given as CSV lines "ticks,level1,level2,level3" (a linear
+  ramp over ticks from the previous keyframe, starting dark) into Pattern.h records. A ramp is split
+  into power of 2 lengths up to 128 ticks at rounded intermediate levels, unchanged levels become
+  holds. Blank lines and lines starting with # are skipped. Used by PatternEncoder and the host tests.
+*/
+
+#ifndef PATTERN_ENCODER_H_
+#define PATTERN_ENCODER_H_
+
+#include <stdio.h>
+#include <string.h>
+#include "../Pattern.h"
+
+struct PatternKey {
+	uint16_t ticks; // from the previous keyframe
+	uint8_t levels[3];
+};
+
+struct PatternRecord {
+	uint8_t n; // ramp over 2^n ticks, or hold when from == to
+	uint8_t ticks;
+	uint8_t from[3];
+	uint8_t to[3];
+
+	bool hold() const {
+		return memcmp(from, to, 3) == 0;
+	}
+};
+
+// parses CSV text into at most max keys, returns their count or -1 with the failing line number
+int parsePatternCsv(const char* text, PatternKey* keys, int max, int& line) {
+	int count = 0;
+	line = 0;
+	while (*text) {
+		line++;
+		const char* end = strchr(text, '\n');
+		if (end == nullptr)
+			end = text + strlen(text);
+		const char* p = text;
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+			p++;
+		if (p < end && *p != '#') {
+			unsigned t, l1, l2, l3;
+			char tail;
+			char row[64] = {};
+			memcpy(row, p, end - p < 63 ? end - p : 63);
+			if (count == max || sscanf(row, "%u ,%u ,%u ,%u %c", &t, &l1, &l2, &l3, &tail) != 4 ||
+					t == 0 || t > 0xffff || l1 > 0xff || l2 > 0xff || l3 > 0xff)
+				return -1;
+			keys[count++] = PatternKey { (uint16_t)t, { (uint8_t)l1, (uint8_t)l2, (uint8_t)l3 } };
+		}
+		text = *end ? end + 1 : end;
+	}
+	return count;
+}
+
+// level at tick t of the ramp from a to b over ticks, rounded half away from a
+inline uint8_t patternLevelAt(uint8_t a, uint8_t b, uint32_t t, uint32_t ticks) {
+	return b >= a ? a + ((b - a) * 2 * t + ticks) / (2 * ticks) : a - ((a - b) * 2 * t + ticks) / (2 * ticks);
+}
+
+// encodes keys into at most max records, returns their count, or -1 when a pattern does not end dark,
+// has a one tick change over 127 or does not fit
+int encodePattern(const PatternKey* keys, int count, PatternRecord* records, int max) {
+	int n = 0;
+	uint8_t levels[3] = {};
+	for (int k = 0; k < count; k++) {
+		const PatternKey& key = keys[k];
+		uint8_t start[3];
+		memcpy(start, levels, 3);
+		uint16_t t = 0;
+		while (t < key.ticks) {
+			if (n == max)
+				return -1;
+			PatternRecord& r = records[n++];
+			memcpy(r.from, levels, 3);
+			bool hold = memcmp(levels, key.levels, 3) == 0;
+			uint16_t left = key.ticks - t;
+			r.n = 0;
+			while (r.n < 7 && (2U << r.n) <= left)
+				r.n++;
+			r.ticks = hold ? (left < 127 ? left : 127) : 1 << r.n;
+			t += r.ticks;
+			for (uint8_t c = 0; c < 3; c++) {
+				r.to[c] = patternLevelAt(start[c], key.levels[c], t, key.ticks);
+				if (r.ticks == 1 && (r.to[c] > r.from[c] + 127 || r.from[c] > r.to[c] + 127))
+					return -1;
+			}
+			memcpy(levels, r.to, 3);
+			if (r.hold() && r.ticks > 127) {
+				r.ticks = 127; // ramp without change, the last tick is held by the next record
+				t--;
+			}
+			if (r.hold() && n > 1 && records[n - 2].hold() && records[n - 2].ticks + r.ticks <= 127) {
+				records[n - 2].ticks += r.ticks; // merge with previous hold
+				n--;
+			}
+		}
+	}
+	return levels[0] == 0 && levels[1] == 0 && levels[2] == 0 ? n : -1;
+}
+
+// record bytes as Pattern.h macros with unmapped levels emit them, returns size including the end mark
+uint16_t patternBytes(const PatternRecord* records, int count, uint8_t* out) {
+	uint16_t size = 0;
+	for (int i = 0; i < count; i++) {
+		const PatternRecord& r = records[i];
+		if (r.hold()) {
+			out[size++] = PATTERN_HOLD(r.ticks);
+			continue;
+		}
+		const uint8_t bytes[] = { PATTERN_RAMP(r.n, r.to[0] - r.from[0], r.to[1] - r.from[1], r.to[2] - r.from[2]) };
+		memcpy(out + size, bytes, sizeof(bytes));
+		size += sizeof(bytes);
+	}
+	out[size++] = PATTERN_END;
+	return size;
+}
+
+// prints records as the initializer of a pattern array
+void printPattern(FILE* f, const PatternRecord* records, int count) {
+	for (int i = 0; i < count; i++) {
+		const PatternRecord& r = records[i];
+		if (r.hold())
+			fprintf(f, "\tPATTERN_HOLD(%u),\n", r.ticks);
+		else
+			fprintf(f, "\tPATTERN_FADE(%u, %u, %u, %u, %u, %u, %u),\n", r.n,
+				r.from[0], r.from[1], r.from[2], r.to[0], r.to[1], r.to[2]);
+	}
+	fprintf(f, "\tPATTERN_END\n");
+}
+
+#endif // PATTERN_ENCODER_H_
@@ -0,0 +1,29 @@
+// Reports the statistics in an EEPROM dump in Intel HEX (file argument or stdin) on stdout
+
+#include "StatsExtractor.h"
+
+char text[64 * 1024];
+uint8_t image[DUMP_SIZE];
+
+int main(int argc, char** argv) {
+	FILE* in = argc > 1 ? fopen(argv[1], "r") : stdin;
+	if (in == nullptr) {
+		fprintf(stderr, "cannot open %s\n", argv[1]);
+		return 1;
+	}
+	size_t length = fread(text, 1, sizeof(text) - 1, in);
+	text[length] = 0;
+	memset(image, 0xff, sizeof(image)); // erased
+	int line;
+	if (!parseIntelHex(text, image, DUMP_SIZE, line)) {
+		fprintf(stderr, "line %d: expected an Intel HEX record within %u bytes\n", line, DUMP_SIZE);
+		return 1;
+	}
+	Dump d;
+	if (!readDump(image, d)) {
+		fprintf(stderr, "no statistics: erased, not yet written at dawn or another layout\n");
+		return 1;
+	}
+	printDump(stdout, d);
+	return 0;
+}
@@ -0,0 +1,175 @@
+/*
+  Statistics extractor: reads the Eeprom struct of Tiny_RGB_Blinker.cpp from an EEPROM dump in Intel HEX
+  (.eep, as avrdude -U eeprom:r:dump.eep:i reads it) and reports the latest statistics slot, the learned
+  night length and the show parameters. Offsets are those of the AVR layout, the firmware asserts them.
+  Used by StatsExtractor and the host tests.
+*/
+
+#ifndef STATS_EXTRACTOR_H_
+#define STATS_EXTRACTOR_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "ToolParams.h"
+
+const uint16_t DUMP_SIZE = 512; // ATtiny85 EEPROM
+const uint8_t DUMP_LAYOUT = 2; // EEPROM_LAYOUT
+const uint8_t DUMP_PARAMS = 2; // offsetof(Eeprom, params)
+const uint8_t DUMP_PARAMS_CHECK = 5;
+const uint8_t DUMP_LAYOUT_OFFSET = 6;
+const uint8_t DUMP_SLOTS_OFFSET = 7;
+const uint8_t DUMP_STATS = 8;
+const uint8_t DUMP_STATS_SIZE = 24; // sizeof(Stats)
+
+// Stats fields
+struct DumpStats {
+	uint32_t cycles;
+	uint32_t usedUAs;
+	uint16_t nights;
+	uint16_t shows;
+	uint16_t fullShows;
+	uint16_t budgetStops;
+	uint16_t lightFlips;
+	uint16_t resets;
+	uint16_t tickClocks;
+	uint16_t lateTicks;
+};
+
+struct Dump {
+	uint8_t slots; // Config::STATS_SLOTS
+	uint8_t slot; // latest
+	uint8_t seq;
+	uint16_t nightLength;
+	uint8_t params[TOOL_PARAMS_SIZE]; // showCycles, dim, effect
+	bool paramsSet; // with a matching paramsCheck, otherwise the firmware uses its Config
+	DumpStats stats;
+};
+
+inline uint8_t hexNibble(char c) {
+	return c >= '0' && c <= '9' ? c - '0' : c >= 'A' && c <= 'F' ? c - 'A' + 10 : c >= 'a' && c <= 'f' ? c - 'a' + 10 : 0xff;
+}
+
+// parses Intel HEX text into image of size bytes (unset bytes are left as they are), returns false with
+// the failing line number on a malformed record, bad checksum or address outside image
+bool parseIntelHex(const char* text, uint8_t* image, uint16_t size, int& line) {
+	uint32_t base = 0;
+	line = 0;
+	while (*text) {
+		line++;
+		const char* end = strchr(text, '\n');
+		if (end == nullptr)
+			end = text + strlen(text);
+		const char* p = text;
+		text = *end ? end + 1 : end;
+		while (end > p && (end[-1] == '\r' || end[-1] == ' '))
+			end--;
+		if (p == end)
+			continue;
+		if (*p++ != ':' || (end - p) % 2 != 0 || end - p < 10)
+			return false;
+		uint8_t record[255 + 5];
+		uint16_t n = (end - p) / 2;
+		uint8_t sum = 0;
+		for (uint16_t i = 0; i < n; i++) {
+			uint8_t h = hexNibble(p[2 * i]), l = hexNibble(p[2 * i + 1]);
+			if (h > 15 || l > 15 || i == sizeof(record))
+				return false;
+			record[i] = h << 4 | l;
+			sum += record[i];
+		}
+		if (sum != 0 || n != record[0] + 5)
+			return false;
+		uint16_t address = record[1] << 8 | record[2];
+		uint8_t type = record[3];
+		if (type == 0) {
+			for (uint8_t i = 0; i < record[0]; i++) {
+				uint32_t a = base + address + i;
+				if (a >= size)
+					return false;
+				image[a] = record[4 + i];
+			}
+		} else if (type == 1)
+			return true;
+		else if (type == 2 && record[0] == 2)
+			base = (uint32_t)(record[4] << 8 | record[5]) << 4;
+		else if (type == 4 && record[0] == 2)
+			base = (uint32_t)(record[4] << 8 | record[5]) << 16;
+		// start addresses (types 3 and 5) are ignored
+	}
+	return true;
+}
+
+// prints image as Intel HEX with 16 byte records
+void printIntelHex(FILE* f, const uint8_t* image, uint16_t size) {
+	for (uint16_t a = 0; a < size; a += 16) {
+		uint8_t n = size - a < 16 ? size - a : 16;
+		uint8_t sum = n + (a >> 8) + a;
+		fprintf(f, ":%02X%04X00", n, a);
+		for (uint8_t i = 0; i < n; i++) {
+			fprintf(f, "%02X", image[a + i]);
+			sum += image[a + i];
+		}
+		fprintf(f, "%02X\n", (uint8_t)-sum);
+	}
+	fprintf(f, ":00000001FF\n");
+}
+
+inline uint16_t dumpWord(const uint8_t* p) {
+	return p[0] | p[1] << 8;
+}
+
+inline uint32_t dumpLong(const uint8_t* p) {
+	return dumpWord(p) | (uint32_t)dumpWord(p + 2) << 16;
+}
+
+// reads the EEPROM image, returns false when it has no statistics of this layout (erased or never at dawn)
+bool readDump(const uint8_t* image, Dump& d) {
+	d.slots = image[DUMP_SLOTS_OFFSET];
+	if (image[DUMP_LAYOUT_OFFSET] != DUMP_LAYOUT || d.slots == 0 || d.slots == 0xff ||
+			DUMP_STATS + d.slots * (DUMP_STATS_SIZE + 1) > DUMP_SIZE)
+		return false;
+	const uint8_t* seqs = image + DUMP_STATS + d.slots * DUMP_STATS_SIZE;
+	d.slot = 0;
+	d.seq = seqs[0];
+	while (d.slot + 1 < d.slots && seqs[d.slot + 1] == (uint8_t)(d.seq + 1)) {
+		d.slot++;
+		d.seq++;
+	}
+	const uint8_t* s = image + DUMP_STATS + d.slot * DUMP_STATS_SIZE;
+	d.stats.cycles = dumpLong(s);
+	d.stats.usedUAs = dumpLong(s + 4);
+	d.stats.nights = dumpWord(s + 8);
+	d.stats.shows = dumpWord(s + 10);
+	d.stats.fullShows = dumpWord(s + 12);
+	d.stats.budgetStops = dumpWord(s + 14);
+	d.stats.lightFlips = dumpWord(s + 16);
+	d.stats.resets = dumpWord(s + 18);
+	d.stats.tickClocks = dumpWord(s + 20);
+	d.stats.lateTicks = dumpWord(s + 22);
+	d.nightLength = dumpWord(image);
+	memcpy(d.params, image + DUMP_PARAMS, TOOL_PARAMS_SIZE);
+	d.paramsSet = image[DUMP_PARAMS_CHECK] == toolParamsCheck(d.params);
+	return true;
+}
+
+void printDump(FILE* f, const Dump& d) {
+	const DumpStats& s = d.stats;
+	fprintf(f, "slot %u of %u, sequence %u\n", d.slot, d.slots, d.seq);
+	fprintf(f, "nights:         %u\n", s.nights);
+	fprintf(f, "night length:   %u periods\n", d.nightLength);
+	fprintf(f, "shows:          %u, %u full, %u budget stops, %u light stops\n", s.shows, s.fullShows,
+		s.budgetStops, (uint16_t)(s.shows - s.fullShows - s.budgetStops));
+	fprintf(f, "lit cycles:     %u\n", s.cycles);
+	fprintf(f, "light flips:    %u\n", s.lightFlips);
+	fprintf(f, "resets:         %u\n", s.resets);
+	fprintf(f, "charge used:    %.3f mAh\n", s.usedUAs / 3600e3);
+	fprintf(f, "tick pass:      %u clocks longest, %u late ticks\n", s.tickClocks, s.lateTicks);
+	if (d.paramsSet)
+		fprintf(f, "params:         %u cycles, dim %u, effect %s\n", d.params[0], d.params[1],
+			toolEffectName(d.params[2]));
+	else
+		fprintf(f, "params:         not set\n");
+}
+
+#endif // STATS_EXTRACTOR_H_
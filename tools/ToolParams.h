@@ -0,0 +1,30 @@
+/*
+  Show parameters as the tools see them: the Params bytes of Tiny_RGB_Blinker.cpp (show cycles, dim,
+  effect), the names of the Effect values and the paramsCheck() byte. Shared by WireSender and
+  StatsExtractor, the host tests assert them against the firmware.
+*/
+
+#ifndef TOOL_PARAMS_H_
+#define TOOL_PARAMS_H_
+
+#include <stdint.h>
+
+const uint8_t TOOL_PARAMS_SIZE = 3; // sizeof(Params)
+
+const char* const TOOL_EFFECT_NAMES[] = { "hues", "one color", "efficient", "pattern", "message" }; // Effect
+const uint8_t TOOL_EFFECTS = sizeof(TOOL_EFFECT_NAMES) / sizeof(TOOL_EFFECT_NAMES[0]);
+
+// paramsCheck()
+inline uint8_t toolParamsCheck(const uint8_t* params) {
+	uint8_t sum = 0x5a;
+	for (uint8_t i = 0; i < TOOL_PARAMS_SIZE; i++)
+		sum += params[i];
+	return sum;
+}
+
+// effect name, "?" for values the firmware does not know
+inline const char* toolEffectName(uint8_t effect) {
+	return effect < TOOL_EFFECTS ? TOOL_EFFECT_NAMES[effect] : "?";
+}
+
+#endif // TOOL_PARAMS_H_
@@ -0,0 +1,37 @@
+// Decodes a trace capture (file argument or stdin) into a timeline and time per state on stdout,
+// with -s the time per state only
+
+#include <string.h>
+#include "TraceDecoder.h"
+
+TraceTimeline timeline;
+
+int main(int argc, char** argv) {
+	bool timelineOut = true;
+	if (argc > 1 && strcmp(argv[1], "-s") == 0) {
+		timelineOut = false;
+		argc--;
+		argv++;
+	}
+	FILE* in = argc > 1 ? fopen(argv[1], "r") : stdin;
+	if (in == nullptr) {
+		fprintf(stderr, "cannot open %s\n", argv[1]);
+		return 1;
+	}
+	char line[128];
+	while (fgets(line, sizeof(line), in)) {
+		uint64_t us;
+		uint8_t e;
+		if (!parseTraceLine(line, us, e))
+			continue;
+		if (timelineOut)
+			printTraceEvent(stdout, us, e);
+		timeline.add(us, e);
+	}
+	if (timeline.events == 0) {
+		fprintf(stderr, "no events, expected lines \"us byte\"\n");
+		return 1;
+	}
+	printTraceSummary(stdout, timeline);
+	return 0;
+}
@@ -0,0 +1,131 @@
+/*
+  Trace decoder: turns event bytes captured from the PB3 trace pin (a 9600 baud UART or logic analyzer
+  capture, as lines "us byte" with the frame start time in microseconds and the byte in hex) into a
+  timeline, and sums the time from each event to the next one per state, the event with its argument.
+  Used by TraceDecoder and the host tests.
+*/
+
+#ifndef TRACE_DECODER_H_
+#define TRACE_DECODER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+// events of TraceEvent in Tiny_RGB_Blinker.cpp, the high 3 bits of the byte
+enum TraceCode : uint8_t {
+	TRACE_CODE_SLEEP, TRACE_CODE_WAKE, TRACE_CODE_ISR, TRACE_CODE_CYCLE, TRACE_CODE_LIGHT, TRACE_CODE_SHOW,
+	TRACE_CODES = 8
+};
+const uint8_t TRACE_ARGS = 32;
+
+const char* const TRACE_CODE_NAMES[TRACE_CODES] = { "sleep", "wake", "isr", "cycle", "light", "show", "?", "?" };
+const char* const TRACE_ISR_NAMES[] = { "wdt", "timer" }; // TraceIsr
+const char* const TRACE_SHOW_NAMES[] = { "boot", "dawn", "pre-dawn", "gesture" }; // ShowStart
+
+// formats the argument of event byte e
+void traceArgument(uint8_t e, char* out, size_t size) {
+	uint8_t a = e & (TRACE_ARGS - 1);
+	switch (e >> 5) {
+		case TRACE_CODE_SLEEP:
+			snprintf(out, size, "%u ms", 16U << a);
+			break;
+		case TRACE_CODE_WAKE:
+			snprintf(out, size, "%s", "");
+			break;
+		case TRACE_CODE_ISR:
+			snprintf(out, size, "%s", a < 2 ? TRACE_ISR_NAMES[a] : "?");
+			break;
+		case TRACE_CODE_CYCLE:
+			snprintf(out, size, a == 0 ? "idle" : "kind %u", a);
+			break;
+		case TRACE_CODE_LIGHT:
+			snprintf(out, size, "level %u", a);
+			break;
+		case TRACE_CODE_SHOW:
+			snprintf(out, size, "%s", a < 4 ? TRACE_SHOW_NAMES[a] : "?");
+			break;
+		default:
+			snprintf(out, size, "0x%02x", e);
+	}
+}
+
+// parses a capture line "us byte", returns false for other lines
+bool parseTraceLine(const char* line, uint64_t& us, uint8_t& e) {
+	unsigned long long t;
+	unsigned b;
+	if (sscanf(line, "%llu %x", &t, &b) != 2 || b > 0xff)
+		return false;
+	us = t;
+	e = b;
+	return true;
+}
+
+// Sums time per state over a stream of events in capture order
+struct TraceTimeline {
+	uint64_t us[TRACE_CODES][TRACE_ARGS]; // time from each event to the next one
+	uint32_t count[TRACE_CODES][TRACE_ARGS];
+	uint64_t first, last; // capture times of the first and last event
+	uint32_t events;
+	uint32_t disorders; // events captured before the previous one, not timed
+	uint8_t state; // last event
+
+	void add(uint64_t t, uint8_t e) {
+		if (events == 0)
+			first = t;
+		else if (t < last)
+			disorders++;
+		else
+			us[state >> 5][state & (TRACE_ARGS - 1)] += t - last;
+		count[e >> 5][e & (TRACE_ARGS - 1)]++;
+		last = t;
+		state = e;
+		events++;
+	}
+
+	// events with code, any argument
+	uint32_t total(uint8_t code) const {
+		uint32_t n = 0;
+		for (uint8_t a = 0; a < TRACE_ARGS; a++)
+			n += count[code][a];
+		return n;
+	}
+
+	// time in states after code, any argument
+	uint64_t time(uint8_t code) const {
+		uint64_t t = 0;
+		for (uint8_t a = 0; a < TRACE_ARGS; a++)
+			t += us[code][a];
+		return t;
+	}
+};
+
+// prints event e captured at us as a timeline line
+void printTraceEvent(FILE* f, uint64_t us, uint8_t e) {
+	char argument[16];
+	traceArgument(e, argument, sizeof(argument));
+	fprintf(f, "%12.6f  %-5s %s\n", us / 1e6, TRACE_CODE_NAMES[e >> 5], argument);
+}
+
+// prints time per state, and the time asleep (watchdog sleeps) and awake
+void printTraceSummary(FILE* f, const TraceTimeline& timeline) {
+	double span = timeline.last - timeline.first;
+	fprintf(f, "%u events over %.3f s", timeline.events, span / 1e6);
+	if (timeline.disorders)
+		fprintf(f, ", %u out of order", timeline.disorders);
+	fprintf(f, "\n%-5s %-10s %8s %14s %8s %12s\n", "state", "", "count", "time s", "share", "mean ms");
+	for (uint8_t c = 0; c < TRACE_CODES; c++)
+		for (uint8_t a = 0; a < TRACE_ARGS; a++) {
+			if (timeline.count[c][a] == 0)
+				continue;
+			char argument[16];
+			traceArgument(c << 5 | a, argument, sizeof(argument));
+			double us = timeline.us[c][a];
+			fprintf(f, "%-5s %-10s %8u %14.3f %7.2f%% %12.3f\n", TRACE_CODE_NAMES[c], argument, timeline.count[c][a],
+				us / 1e6, span > 0 ? 100 * us / span : 0, us / 1e3 / timeline.count[c][a]);
+		}
+	double asleep = timeline.time(TRACE_CODE_SLEEP);
+	fprintf(f, "asleep %.3f s (%.2f%%), awake %.3f s\n", asleep / 1e6, span > 0 ? 100 * asleep / span : 0,
+		(span - asleep) / 1e6);
+}
+
+#endif // TRACE_DECODER_H_
@@ -0,0 +1,67 @@
+/*
+  Sends show parameters to a blinker through a serial port adapter with TX on PB3 (and a common ground):
+  holds the line low with a break while the blinker is powered up, releases it and sends the message.
+  The blinker acknowledges valid parameters with a 256ms LED1 blink. Without a device the message bytes
+  are printed.
+
+    WireSender showCycles dim effect [device]
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "WireSender.h"
+
+int main(int argc, char** argv) {
+	if (argc < 4 || argc > 5) {
+		fprintf(stderr, "usage: %s showCycles dim effect [device]\n  showCycles 1..255, dim 0..7, effect", argv[0]);
+		for (uint8_t e = 0; e < TOOL_EFFECTS; e++)
+			fprintf(stderr, " %u %s%s", e, toolEffectName(e), e + 1 < TOOL_EFFECTS ? "," : "\n");
+		return 1;
+	}
+	unsigned long showCycles = strtoul(argv[1], nullptr, 0);
+	unsigned long dim = strtoul(argv[2], nullptr, 0);
+	unsigned long effect = strtoul(argv[3], nullptr, 0);
+	if (!wireParamsValid(showCycles, dim, effect)) {
+		fprintf(stderr, "parameters out of range\n");
+		return 1;
+	}
+	uint8_t m[WIRE_MESSAGE_SIZE];
+	wireMessage(showCycles, dim, effect, m);
+	if (argc == 4) {
+		for (uint8_t i = 0; i < WIRE_MESSAGE_SIZE; i++)
+			printf("%02x%c", m[i], i + 1 < WIRE_MESSAGE_SIZE ? ' ' : '\n');
+		return 0;
+	}
+
+	int fd = open(argv[4], O_RDWR | O_NOCTTY);
+	termios tty;
+	if (fd < 0 || tcgetattr(fd, &tty) != 0) {
+		fprintf(stderr, "cannot open %s\n", argv[4]);
+		return 1;
+	}
+	cfmakeraw(&tty);
+	cfsetispeed(&tty, B9600);
+	cfsetospeed(&tty, B9600);
+	tty.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+	tty.c_cflag |= CLOCAL | CREAD | CS8;
+	if (tcsetattr(fd, TCSANOW, &tty) != 0 || ioctl(fd, TIOCSBRK) != 0) {
+		fprintf(stderr, "cannot set up %s\n", argv[4]);
+		return 1;
+	}
+	fprintf(stderr, "power up the blinker, then press Enter within 8 s\n");
+	getchar();
+	ioctl(fd, TIOCCBRK);
+	usleep(10000); // blinker sees the release
+	if (write(fd, m, sizeof(m)) != sizeof(m) || tcdrain(fd) != 0) {
+		fprintf(stderr, "cannot send to %s\n", argv[4]);
+		return 1;
+	}
+	fprintf(stderr, "sent, LED1 blinks when the blinker has saved them\n");
+	close(fd);
+	return 0;
+}
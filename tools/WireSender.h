@@ -0,0 +1,56 @@
+/*
+  Configuration wire sender: the message wireConfig() in Tiny_RGB_Blinker.cpp receives on PB3 at boot,
+  'P', the Params bytes (show cycles, dim, effect) and their check byte as 9600 baud 8N1, and the level
+  of the wire while it is sent. Used by WireSender and the host tests.
+*/
+
+#ifndef WIRE_SENDER_H_
+#define WIRE_SENDER_H_
+
+#include <stdint.h>
+#include "ToolParams.h"
+
+const uint8_t WIRE_MESSAGE_SIZE = 2 + TOOL_PARAMS_SIZE;
+const uint32_t WIRE_BAUD = 9600;
+
+// true for parameters paramsValid() accepts
+inline bool wireParamsValid(unsigned showCycles, unsigned dim, unsigned effect) {
+	return showCycles >= 1 && showCycles <= 255 && dim < 8 && effect < TOOL_EFFECTS;
+}
+
+void wireMessage(uint8_t showCycles, uint8_t dim, uint8_t effect, uint8_t* m) {
+	m[0] = 'P';
+	m[1] = showCycles;
+	m[2] = dim;
+	m[3] = effect;
+	m[4] = toolParamsCheck(m + 1);
+}
+
+// Wire held low from power up until release, then idle high until the frames of bytes sent back to back
+// from start, times in us from power up
+struct WireWaveform {
+	const uint8_t* bytes;
+	uint8_t size;
+	uint64_t release;
+	uint64_t start;
+
+	bool level(uint64_t us) const {
+		if (us < release)
+			return false;
+		if (us < start)
+			return true;
+		uint64_t bit = (us - start) * WIRE_BAUD / 1000000;
+		uint64_t frame = bit / 10;
+		bit %= 10;
+		if (frame >= size || bit == 9)
+			return true; // idle or stop bit
+		return bit != 0 && (bytes[frame] >> (bit - 1) & 1); // start bit, then data bits LSB first
+	}
+
+	// end of the last stop bit
+	uint64_t end() const {
+		return start + (size * 10 * 1000000ULL + WIRE_BAUD - 1) / WIRE_BAUD;
+	}
+};
+
+#endif // WIRE_SENDER_H_